@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <string>
+
+// Runs the body `repeats` times and prints the best wall time
+template<typename Body>
+double Measure(const std::string& name, int repeats, Body body) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeats; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        body();
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::cout << name << ": " << best << " ms" << std::endl;
+    return best;
+}
+
+class Timer {
+    std::chrono::steady_clock::time_point start_;
+    double elapsed_ = 0;
+
+public:
+    void start() {
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    void stop() {
+        elapsed_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    double elapsed() const {
+        return elapsed_;
+    }
+};
+
+// Like Measure, but only the part of the body between timer.start() and timer.stop() counts
+template<typename Body>
+double MeasureRun(const std::string& name, int repeats, Body body) {
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeats; ++i) {
+        Timer timer;
+        body(timer);
+        best = std::min(best, timer.elapsed());
+    }
+
+    std::cout << name << ": " << best << " ms" << std::endl;
+    return best;
+}
@@ -0,0 +1,48 @@
+#include "lib/scheduler.h"
+#include "bench_utils.h"
+
+#include <vector>
+
+// Dynamic countdown vs level-synchronous execution on a wide shallow graph
+// (many independent per-record transforms) and on a deep narrow one.
+namespace {
+
+void Build(TTaskScheduler& scheduler, size_t width, size_t depth) {
+    std::vector<int> layer;
+    for (size_t i = 0; i < width; ++i) {
+        layer.push_back(scheduler.add([](int x) { return x * 3 + 1; }, static_cast<int>(i)));
+    }
+
+    for (size_t level = 1; level < depth; ++level) {
+        for (int& id : layer) {
+            id = scheduler.add([](int x) { return x / 2 + 7; }, scheduler.getFutureResult<int>(id));
+        }
+    }
+
+    scheduler.finalize();
+}
+
+void Compare(const std::string& name, size_t width, size_t depth) {
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+
+    for (auto [engine, engine_name] : {
+            std::pair{ExecutionEngine::Dynamic, "dynamic"},
+            std::pair{ExecutionEngine::Levels, "levels"}}) {
+        double best = MeasureRun(name + " " + engine_name, 5, [&](auto& timer) {
+            TTaskScheduler scheduler(TaskPoolOptions{.workers = workers, .max_workers = workers});
+            Build(scheduler, width, depth);
+
+            timer.start();
+            scheduler.executeAll(engine);
+            timer.stop();
+        });
+        std::cout << "  per task: " << best * 1e6 / (width * depth) << " ns" << std::endl;
+    }
+}
+
+}
+
+int main() {
+    Compare("wide 20000x4", 20000, 4);
+    Compare("deep 16x2000", 16, 2000);
+}
@@ -0,0 +1,53 @@
+#include "lib/scheduler.h"
+#include "bench_utils.h"
+
+#include <numeric>
+#include <vector>
+
+// Memory-bound graph: every chain fills a large buffer, transforms it and reduces it,
+// so the time is dominated by where the intermediate vectors live relative to their consumers.
+namespace {
+
+constexpr size_t kChains = 32;
+constexpr size_t kBufferSize = 1 << 21;
+
+void RunChains(const TaskPoolOptions& options) {
+    TTaskScheduler scheduler(options);
+
+    auto fill = [](size_t seed) {
+        std::vector<double> buffer(kBufferSize);
+        std::iota(buffer.begin(), buffer.end(), static_cast<double>(seed));
+        return buffer;
+    };
+
+    auto transform = [](const std::vector<double>& buffer) {
+        std::vector<double> result(buffer.size());
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            result[i] = buffer[i] * 2 + 1;
+        }
+        return result;
+    };
+
+    auto reduce = [](const std::vector<double>& buffer) {
+        return std::accumulate(buffer.begin(), buffer.end(), 0.0);
+    };
+
+    for (size_t chain = 0; chain < kChains; ++chain) {
+        int id1 = scheduler.add(fill, chain);
+        int id2 = scheduler.add(transform, scheduler.getFutureResult<std::vector<double>>(id1));
+        scheduler.add(reduce, scheduler.getFutureResult<std::vector<double>>(id2));
+    }
+
+    scheduler.executeAll();
+}
+
+}
+
+int main() {
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "workers: " << workers << ", NUMA nodes: " << CpuTopology::Detect().NodesCount() << std::endl;
+
+    Measure("affinity none", 5, [&] { RunChains({.workers = workers, .affinity = AffinityPolicy::None}); });
+    Measure("affinity node", 5, [&] { RunChains({.workers = workers, .affinity = AffinityPolicy::Node}); });
+    Measure("affinity cpu", 5, [&] { RunChains({.workers = workers, .affinity = AffinityPolicy::Cpu}); });
+}
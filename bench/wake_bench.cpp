@@ -0,0 +1,39 @@
+#include "lib/scheduler.h"
+#include "bench_utils.h"
+
+// Wake latency: a long chain of tiny dependent tasks, every hop hands the next task
+// to a worker that has just gone idle, so the time per hop is the hand-off cost.
+namespace {
+
+constexpr int kChainLength = 20000;
+
+// Only executeAll is timed, building the scheduler and the chain is not part of a hop
+void RunChain(const TaskPoolOptions& options, Timer& timer) {
+    TTaskScheduler scheduler(options);
+
+    int id = scheduler.add([](int x) { return x + 1; }, 0);
+    for (int i = 1; i < kChainLength; ++i) {
+        id = scheduler.add([](int x) { return x + 1; }, scheduler.getFutureResult<int>(id));
+    }
+
+    timer.start();
+    scheduler.executeAll();
+    timer.stop();
+}
+
+}
+
+int main() {
+    using namespace std::chrono_literals;
+
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "workers: " << workers << ", chain: " << kChainLength << std::endl;
+
+    for (auto spin : {0us, 10us, 50us, 200us}) {
+        TaskPoolOptions options{.workers = workers, .max_workers = workers, .spin_for = spin};
+        double ms = MeasureRun("spin " + std::to_string(spin.count()) + "us", 5, [&](Timer& timer) {
+            RunChain(options, timer);
+        });
+        std::cout << "  per hop: " << ms * 1000 / kChainLength << " us" << std::endl;
+    }
+}
@@ -2,7 +2,9 @@
 
 #include <memory>
 #include <stdexcept>
+#include <type_traits>
 #include <typeinfo>
+#include <utility>
 
 template<typename T>
 struct remove_reference {
@@ -59,9 +61,17 @@ class AnyType {
         Holder(const T& val) : val_(val) {}
         Holder(T&& val) : val_(std::move(val)) {}
 
+        // builds the value straight from the maker's return value, no copy or move
+        template<typename Maker>
+        Holder(std::in_place_t, Maker&& make) : val_(std::forward<Maker>(make)()) {}
+
         std::unique_ptr<BaseHolder> clone() override {
-            return std::make_unique<Holder<T>>(val_);
-        } 
+            if constexpr (std::is_copy_constructible_v<T>) {
+                return std::make_unique<Holder<T>>(val_);
+            } else {
+                throw std::runtime_error("AnyType holds a value that can not be copied");
+            }
+        }
 
         size_t type() const override {
             return type_id<T>();
@@ -93,9 +103,15 @@ public:
 
     AnyType& operator=(AnyType&& other) noexcept = default;
 
+    // Replaces the value with the one returned by make(), constructed in place
+    template<typename T, typename Maker>
+    void emplace_with(Maker&& make) {
+        holder_ = std::make_unique<Holder<T>>(std::in_place, std::forward<Maker>(make));
+    }
+
     bool has_value() const noexcept {
         return holder_ != nullptr;
-    }    
+    }
 
     size_t type() const {
         if (!holder_) {
@@ -115,6 +131,9 @@ public:
 
     template<typename T>
     friend T any_cast(const AnyType& any);
+
+    template<typename T>
+    friend const my_decay_t<T>& any_cast_ref(const AnyType& any);
 };
 
 template<typename T>
@@ -126,3 +145,14 @@ T any_cast(const AnyType& any) {
     auto* ptr = dynamic_cast<AnyType::Holder<my_decay_t<T>>*>(any.holder_.get());
     return ptr->val_;
 }
+
+// Same checks as any_cast, but returns a reference to the stored value instead of a copy
+template<typename T>
+const my_decay_t<T>& any_cast_ref(const AnyType& any) {
+    if(!any.has_value() || type_id<my_decay_t<T>>() != any.type()) {
+        throw std::runtime_error("bad cast");
+    }
+
+    auto* ptr = static_cast<AnyType::Holder<my_decay_t<T>>*>(any.holder_.get());
+    return ptr->val_;
+}
@@ -0,0 +1,280 @@
+#include "graph_file.h"
+
+#include <fstream>
+#include <sstream>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kMagic = 0x31475354;  // "TSG1"
+// version 2 added the executor of every task, version 1 files load onto the compute executor
+constexpr uint32_t kVersion = 2;
+
+// kind, payload size, in_degree and children count, the smallest a node can take in any version
+constexpr size_t kMinNodeBytes = 4 * sizeof(uint32_t);
+
+// Read-only view of a whole file, mmap-ed where it is available
+class MappedFile {
+    std::string_view data_;
+#ifdef __unix__
+    void* mapping_ = nullptr;
+#else
+    std::string buffer_;
+#endif
+
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef __unix__
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("can not open graph file: " + path);
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error("can not stat graph file: " + path);
+        }
+
+        if (info.st_size > 0) {
+            mapping_ = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+
+        if (mapping_ == MAP_FAILED) {
+            mapping_ = nullptr;
+            throw std::runtime_error("can not map graph file: " + path);
+        }
+
+        data_ = std::string_view(static_cast<const char*>(mapping_), info.st_size);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("can not open graph file: " + path);
+        }
+
+        std::stringstream stream;
+        stream << file.rdbuf();
+        buffer_ = stream.str();
+        data_ = buffer_;
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef __unix__
+        if (mapping_) {
+            munmap(mapping_, data_.size());
+        }
+#endif
+    }
+
+    std::string_view data() const {
+        return data_;
+    }
+};
+
+}
+
+void TTaskScheduler::save(const std::string& path, const TaskRegistry& registry) const {
+    GraphWriter writer;
+    std::vector<std::string> kinds;
+    std::unordered_map<std::string, uint32_t> kind_index;
+    std::vector<uint32_t> node_kinds(next_id);
+    std::vector<std::string> payloads(next_id);
+    std::vector<uint32_t> degrees(next_id, 0);
+
+    std::vector<std::string> executors(pools.size());
+    for (const auto& [name, executor] : executor_names) {
+        executors[executor] = name;
+    }
+
+    for (int id = 0; id < next_id; ++id) {
+        const BaseSchedule& task = *tasks.at(id);
+        const std::string& name = registry.name(task.kind());
+
+        auto [it, inserted] = kind_index.emplace(name, kinds.size());
+        if (inserted) {
+            kinds.push_back(name);
+        }
+        node_kinds[id] = it->second;
+
+        GraphWriter payload;
+        if (!task.save(payload)) {
+            throw std::runtime_error("task " + std::to_string(id) + " has an input that is not serializable");
+        }
+        payloads[id] = payload.data();
+
+        // in_degree is consumed by execution, so the original one is recounted from the edges
+        auto edges = out_edges.find(id);
+        if (edges != out_edges.end()) {
+            for (int child : edges->second) {
+                degrees[child]++;
+            }
+        }
+    }
+
+    writer.write(kMagic);
+    writer.write(kVersion);
+    writer.write<uint32_t>(next_id);
+    writer.write<uint32_t>(kinds.size());
+    for (const auto& name : kinds) {
+        writer.write(name);
+    }
+
+    writer.write<uint32_t>(executors.size());
+    for (const auto& name : executors) {
+        writer.write(name);
+    }
+
+    for (int id = 0; id < next_id; ++id) {
+        writer.write(node_kinds[id]);
+        writer.write<uint32_t>(executor_of.at(id));
+        writer.write<uint32_t>(payloads[id].size());
+        writer.writeBytes(payloads[id]);
+    }
+
+    for (int id = 0; id < next_id; ++id) {
+        writer.write(degrees[id]);
+
+        auto edges = out_edges.find(id);
+        std::vector<int32_t> children;
+        if (edges != out_edges.end()) {
+            children.assign(edges->second.begin(), edges->second.end());
+        }
+        writer.write(children);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(writer.data().data(), writer.size());
+    if (!file) {
+        throw std::runtime_error("can not write graph file: " + path);
+    }
+}
+
+void TTaskScheduler::load(const std::string& path, const TaskRegistry& registry) {
+    if (next_id != 0) {
+        throw std::runtime_error("graph can be loaded only into an empty scheduler");
+    }
+
+    try {
+        loadFrom(path, registry);
+    } catch (...) {
+        tasks.clear();
+        in_degree.clear();
+        executed.clear();
+        executor_of.clear();
+        out_edges.clear();
+        shared_tasks.clear();
+        finalized = false;
+        next_id = 0;
+        throw;
+    }
+}
+
+void TTaskScheduler::loadFrom(const std::string& path, const TaskRegistry& registry) {
+    MappedFile file(path);
+    GraphReader reader(file.data());
+
+    if (reader.read<uint32_t>() != kMagic) {
+        throw std::runtime_error("not a task graph file: " + path);
+    }
+
+    uint32_t version = reader.read<uint32_t>();
+    if (version != 1 && version != kVersion) {
+        throw std::runtime_error("not a task graph file: " + path);
+    }
+
+    uint32_t nodes = reader.read<uint32_t>();
+    uint32_t kinds_count = reader.read<uint32_t>();
+
+    // counts are checked against the rest of the file before anything is reserved for them,
+    // every name takes at least its size prefix
+    if (kinds_count > reader.remaining() / sizeof(uint32_t) || nodes > reader.remaining() / kMinNodeBytes) {
+        throw std::runtime_error("corrupted graph file: " + path);
+    }
+
+    std::vector<const TaskRegistry::Loader*> loaders;
+    for (uint32_t i = 0; i < kinds_count; ++i) {
+        loaders.push_back(&registry.loader(reader.read<std::string>()));
+    }
+
+    // executors are matched by name, so the loading scheduler has to register the named ones
+    std::vector<size_t> executors{0};
+    if (version >= 2) {
+        uint32_t executors_count = reader.read<uint32_t>();
+        if (executors_count > reader.remaining() / sizeof(uint32_t)) {
+            throw std::runtime_error("corrupted graph file: " + path);
+        }
+
+        executors.resize(executors_count);
+        for (size_t& executor : executors) {
+            executor = executorIndex(reader.read<std::string>());
+        }
+    }
+
+    tasks.reserve(nodes);
+    in_degree.reserve(nodes);
+    executed.reserve(nodes);
+    executor_of.reserve(nodes);
+    out_edges.reserve(nodes);
+
+    for (uint32_t id = 0; id < nodes; ++id) {
+        uint32_t kind = reader.read<uint32_t>();
+        uint32_t executor = version >= 2 ? reader.read<uint32_t>() : 0;
+        if (kind >= loaders.size() || executor >= executors.size()) {
+            throw std::runtime_error("corrupted graph file: " + path);
+        }
+        executor_of[id] = executors[executor];
+
+        GraphReader payload(reader.readBytes(reader.read<uint32_t>()));
+        tasks[id] = (*loaders[kind])(payload, tasks);
+    }
+
+    std::vector<uint32_t> stored_degrees(nodes);
+    std::vector<uint32_t> degrees(nodes, 0);
+    for (uint32_t id = 0; id < nodes; ++id) {
+        stored_degrees[id] = reader.read<uint32_t>();
+        executed[id] = false;
+
+        std::vector<int32_t> children = reader.read<std::vector<int32_t>>();
+        for (int32_t child : children) {
+            if (child < 0 || static_cast<uint32_t>(child) >= nodes) {
+                throw std::runtime_error("corrupted graph file: " + path);
+            }
+            degrees[child]++;
+        }
+
+        if (!children.empty()) {
+            out_edges[id].assign(children.begin(), children.end());
+        }
+    }
+
+    // a wrong in_degree would start a task before its inputs or never start it
+    if (stored_degrees != degrees) {
+        throw std::runtime_error("corrupted graph file: " + path);
+    }
+
+    for (uint32_t id = 0; id < nodes; ++id) {
+        in_degree[id] = degrees[id];
+    }
+
+    next_id = nodes;
+    finalize();
+
+    if (deduplicate) {
+        for (int id = 0; id < next_id; ++id) {
+            if (auto key = tasks[id]->fingerprint()) {
+                shared_tasks.emplace(*key, id);
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "scheduler.h"
+
+// Maps schedule kinds to stable names and back to functors when a saved graph is loaded.
+// The template arguments have to match the ones deduced by TTaskScheduler::add.
+class TaskRegistry {
+public:
+    using Loader = std::function<std::shared_ptr<BaseSchedule>(GraphReader&, const TaskMap&)>;
+
+    template<typename T, typename Functor>
+    void addOne(const std::string& name, Functor func) {
+        insert(name, type_id<ScheduleOfOne<Functor, T>>(), [func](GraphReader& reader, const TaskMap& tasks) {
+            return ScheduleOfOne<Functor, T>::load(func, reader, tasks);
+        });
+    }
+
+    template<typename T, typename U = T, typename Functor>
+    void addTwo(const std::string& name, Functor func) {
+        insert(name, type_id<ScheduleOfTwo<Functor, T, U>>(), [func](GraphReader& reader, const TaskMap& tasks) {
+            return ScheduleOfTwo<Functor, T, U>::load(func, reader, tasks);
+        });
+    }
+
+    template<typename Class, typename RetType, typename Arg>
+    void addMethod(const std::string& name, RetType (Class::*func)(Arg), Class obj) {
+        using schedule = ScheduleOfOneMethod<Class, RetType, Arg>;
+        insert(name, type_id<schedule>(), [func, obj](GraphReader& reader, const TaskMap& tasks) {
+            return schedule::load(func, obj, reader, tasks);
+        });
+    }
+
+    const std::string& name(size_t kind) const {
+        auto it = names.find(kind);
+        if (it == names.end()) {
+            throw std::runtime_error("task functor is not registered");
+        }
+        return it->second;
+    }
+
+    const Loader& loader(const std::string& name) const {
+        auto it = loaders.find(name);
+        if (it == loaders.end()) {
+            throw std::runtime_error("unknown task kind: " + name);
+        }
+        return it->second;
+    }
+
+private:
+    void insert(const std::string& name, size_t kind, Loader loader) {
+        if (loaders.contains(name)) {
+            throw std::runtime_error("task kind is already registered: " + name);
+        }
+
+        names[kind] = name;
+        loaders[name] = std::move(loader);
+    }
+
+    std::unordered_map<size_t, std::string> names;
+    std::unordered_map<std::string, Loader> loaders;
+};
@@ -0,0 +1,209 @@
+#include "metrics.h"
+
+#include <bit>
+#include <sstream>
+#include <utility>
+
+size_t LatencyHistogram::BucketIndex(uint64_t ns) {
+    if (ns < kSubBuckets) {
+        return ns;
+    }
+
+    size_t exponent = std::bit_width(ns) - 1;
+    size_t sub_bucket = (ns >> (exponent - kSubBucketsLog)) & (kSubBuckets - 1);
+    return (exponent - kSubBucketsLog + 1) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+
+    size_t exponent = index / kSubBuckets + kSubBucketsLog - 1;
+    uint64_t sub_bucket = index % kSubBuckets;
+    uint64_t width = uint64_t(1) << (exponent - kSubBucketsLog);
+    return ((kSubBuckets + sub_bucket) << (exponent - kSubBucketsLog)) + width - 1;
+}
+
+HistogramSnapshot LatencyHistogram::Snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.counts.resize(kBuckets);
+    for (size_t i = 0; i < kBuckets; ++i) {
+        snapshot.counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+
+    snapshot.sum_ns = sum_ns_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void HistogramSnapshot::Merge(const HistogramSnapshot& other) {
+    if (counts.size() < other.counts.size()) {
+        counts.resize(other.counts.size());
+    }
+
+    for (size_t i = 0; i < other.counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+
+    count += other.count;
+    sum_ns += other.sum_ns;
+}
+
+uint64_t HistogramSnapshot::Percentile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return LatencyHistogram::BucketUpperBound(i);
+        }
+    }
+
+    return LatencyHistogram::BucketUpperBound(counts.size() - 1);
+}
+
+namespace {
+
+void FormatHistogram(std::ostream& out, const std::string& name, const HistogramSnapshot& histogram) {
+    out << name << ": count " << histogram.count;
+    if (histogram.count > 0) {
+        out << ", mean " << histogram.sum_ns / histogram.count << "ns"
+            << ", p50 " << histogram.Percentile(0.5) << "ns"
+            << ", p99 " << histogram.Percentile(0.99) << "ns"
+            << ", max " << histogram.Percentile(1.0) << "ns";
+    }
+    out << '\n';
+}
+
+// The compute pool first, then the other executors by name
+std::vector<std::pair<std::string, const TaskPoolStats*>> Pools(const SchedulerStats& stats) {
+    std::vector<std::pair<std::string, const TaskPoolStats*>> pools{{"compute", &stats.pool}};
+    for (const auto& [name, executor] : stats.executors) {
+        pools.emplace_back(name, &executor);
+    }
+    return pools;
+}
+
+// executor="name" with the label value escaped as the exposition format requires
+std::string ExecutorLabel(const std::string& name) {
+    std::string label = "executor=\"";
+    for (char c : name) {
+        if (c == '\\' || c == '"') {
+            label += '\\';
+            label += c;
+        } else if (c == '\n') {
+            label += "\\n";
+        } else {
+            label += c;
+        }
+    }
+    return label + '"';
+}
+
+void PrometheusHeader(std::ostream& out, const std::string& name, const std::string& help, const char* type) {
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n';
+}
+
+void PrometheusCounter(std::ostream& out, const std::string& name, const std::string& help, double value) {
+    PrometheusHeader(out, name, help, "counter");
+    out << name << ' ' << value << '\n';
+}
+
+// One family with a series per executor, value(pool) gives the sample
+template<typename Value>
+void PrometheusPools(std::ostream& out, const std::string& name, const std::string& help, const char* type,
+        const std::vector<std::pair<std::string, const TaskPoolStats*>>& pools, Value value) {
+    PrometheusHeader(out, name, help, type);
+    for (const auto& [executor, pool] : pools) {
+        out << name << '{' << ExecutorLabel(executor) << "} " << value(*pool) << '\n';
+    }
+}
+
+// Only the non-empty buckets are exposed, cumulative counts keep the series valid
+void PrometheusHistogram(std::ostream& out, const std::string& name, const std::string& help,
+        const std::vector<std::pair<std::string, const TaskPoolStats*>>& pools,
+        HistogramSnapshot TaskPoolStats::*member) {
+    PrometheusHeader(out, name, help, "histogram");
+
+    for (const auto& [executor, pool] : pools) {
+        const HistogramSnapshot& histogram = pool->*member;
+        const std::string label = ExecutorLabel(executor);
+
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < histogram.counts.size(); ++i) {
+            if (histogram.counts[i] == 0) {
+                continue;
+            }
+
+            cumulative += histogram.counts[i];
+            out << name << "_bucket{" << label << ",le=\"" << LatencyHistogram::BucketUpperBound(i) * 1e-9
+                << "\"} " << cumulative << '\n';
+        }
+
+        out << name << "_bucket{" << label << ",le=\"+Inf\"} " << histogram.count << '\n'
+            << name << "_sum{" << label << "} " << histogram.sum_ns * 1e-9 << '\n'
+            << name << "_count{" << label << "} " << histogram.count << '\n';
+    }
+}
+
+void FormatPool(std::ostream& out, const TaskPoolStats& pool) {
+    out << "  workers: " << pool.workers << '\n'
+        << "  tasks executed: " << pool.tasks_executed << '\n'
+        << "  enqueues: " << pool.enqueues << '\n'
+        << "  steals: " << pool.steals << '\n'
+        << "  idle parks: " << pool.idle_parks << '\n'
+        << "  queue high water: " << pool.queue_high_water << '\n'
+        << "  queue_mutex wait: " << pool.queue_mutex_wait_ns << "ns\n"
+        << "  pin failures: " << pool.pin_failures << '\n';
+
+    FormatHistogram(out, "  task run time", pool.run_time);
+    FormatHistogram(out, "  ready to start latency", pool.ready_latency);
+}
+
+}
+
+std::string FormatStats(const SchedulerStats& stats) {
+    std::stringstream out;
+
+    out << "sched_mutex wait: " << stats.sched_mutex_wait_ns << "ns\n";
+    for (const auto& [name, pool] : Pools(stats)) {
+        out << "executor " << name << ":\n";
+        FormatPool(out, *pool);
+    }
+    return out.str();
+}
+
+std::string FormatPrometheus(const SchedulerStats& stats, const std::string& prefix) {
+    const auto pools = Pools(stats);
+    std::stringstream out;
+
+    PrometheusPools(out, prefix + "_workers", "Live worker threads.", "gauge", pools,
+        [](const TaskPoolStats& pool) { return pool.workers; });
+    PrometheusPools(out, prefix + "_tasks_executed_total", "Tasks executed by the pool.", "counter", pools,
+        [](const TaskPoolStats& pool) { return pool.tasks_executed; });
+    PrometheusPools(out, prefix + "_enqueues_total", "Tasks pushed to the pool queues.", "counter", pools,
+        [](const TaskPoolStats& pool) { return pool.enqueues; });
+    PrometheusPools(out, prefix + "_steals_total", "Tasks taken from another NUMA node queue.", "counter", pools,
+        [](const TaskPoolStats& pool) { return pool.steals; });
+    PrometheusPools(out, prefix + "_idle_parks_total", "Times a worker parked waiting for tasks.", "counter", pools,
+        [](const TaskPoolStats& pool) { return pool.idle_parks; });
+    PrometheusPools(out, prefix + "_queue_high_water", "Largest number of queued tasks.", "gauge", pools,
+        [](const TaskPoolStats& pool) { return pool.queue_high_water; });
+    PrometheusPools(out, prefix + "_queue_mutex_wait_seconds_total",
+        "Time spent waiting for the contended queue mutex.", "counter", pools,
+        [](const TaskPoolStats& pool) { return pool.queue_mutex_wait_ns * 1e-9; });
+    PrometheusPools(out, prefix + "_pin_failures", "Workers running unpinned because pinning failed.", "gauge",
+        pools, [](const TaskPoolStats& pool) { return pool.pin_failures; });
+    PrometheusCounter(out, prefix + "_sched_mutex_wait_seconds_total",
+        "Time spent waiting for the contended scheduler mutex.", stats.sched_mutex_wait_ns * 1e-9);
+    PrometheusHistogram(out, prefix + "_task_run_seconds", "Task execution time.", pools, &TaskPoolStats::run_time);
+    PrometheusHistogram(out, prefix + "_task_ready_latency_seconds",
+        "Time from enqueue to the start of execution.", pools, &TaskPoolStats::ready_latency);
+    return out.str();
+}
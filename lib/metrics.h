@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct HistogramSnapshot {
+    std::vector<uint64_t> counts;
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+
+    // Upper bound of the bucket holding the q-th quantile, 0 for an empty histogram
+    uint64_t Percentile(double q) const;
+
+    void Merge(const HistogramSnapshot& other);
+};
+
+// With a single writer the update is a plain relaxed load + store, no locked instruction
+inline void BumpCounter(std::atomic<uint64_t>& counter, uint64_t value, bool single_writer) {
+    if (single_writer) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    } else {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+// Log-linear histogram of durations in nanoseconds: every power of two is split into
+// kSubBuckets linear buckets, so values are kept with ~12% precision like in HdrHistogram
+class LatencyHistogram {
+public:
+    static constexpr size_t kSubBucketsLog = 3;
+    static constexpr size_t kSubBuckets = 1 << kSubBucketsLog;
+    static constexpr size_t kBuckets = (64 - kSubBucketsLog + 1) * kSubBuckets;
+
+    static size_t BucketIndex(uint64_t ns);
+    static uint64_t BucketUpperBound(size_t index);
+
+    void Record(uint64_t ns, bool single_writer) {
+        BumpCounter(buckets_[BucketIndex(ns)], 1, single_writer);
+        BumpCounter(sum_ns_, ns, single_writer);
+    }
+
+    HistogramSnapshot Snapshot() const;
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> sum_ns_ = 0;
+};
+
+// Counters owned by one worker, so updates are relaxed and never contended.
+// The slot shared by non-worker threads is created with single_writer = false
+struct alignas(64) WorkerMetrics {
+    explicit WorkerMetrics(bool single = true) : single_writer(single) {}
+
+    const bool single_writer;
+
+    std::atomic<uint64_t> tasks_executed = 0;
+    std::atomic<uint64_t> steals = 0;
+    std::atomic<uint64_t> enqueues = 0;
+    std::atomic<uint64_t> idle_parks = 0;
+    std::atomic<uint64_t> queue_mutex_wait_ns = 0;
+
+    LatencyHistogram run_time;
+    LatencyHistogram ready_latency;
+
+    void Add(std::atomic<uint64_t>& counter, uint64_t value = 1) {
+        BumpCounter(counter, value, single_writer);
+    }
+
+    void Record(LatencyHistogram& histogram, uint64_t ns) {
+        histogram.Record(ns, single_writer);
+    }
+};
+
+struct TaskPoolStats {
+    size_t workers = 0;
+    uint64_t tasks_executed = 0;
+    uint64_t steals = 0;
+    uint64_t enqueues = 0;
+    uint64_t idle_parks = 0;
+    uint64_t queue_high_water = 0;
+    uint64_t queue_mutex_wait_ns = 0;
+    uint64_t pin_failures = 0;
+
+    HistogramSnapshot run_time;
+    HistogramSnapshot ready_latency;
+};
+
+struct SchedulerStats {
+    // the compute pool
+    TaskPoolStats pool;
+    uint64_t sched_mutex_wait_ns = 0;
+    // pools of the other executors by name
+    std::map<std::string, TaskPoolStats> executors;
+};
+
+// Locks the mutex and, only when it is contended, adds the time spent waiting to wait_ns
+inline std::unique_lock<std::mutex> TimedLock(std::mutex& mutex, std::atomic<uint64_t>& wait_ns) {
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        const auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        const auto waited = std::chrono::steady_clock::now() - start;
+        wait_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+            std::memory_order_relaxed);
+    }
+    return lock;
+}
+
+// Human readable dump
+std::string FormatStats(const SchedulerStats& stats);
+
+// Prometheus text exposition format, the pool series carry an executor label
+std::string FormatPrometheus(const SchedulerStats& stats, const std::string& prefix = "task_scheduler");
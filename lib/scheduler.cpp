@@ -1,32 +1,303 @@
 #include "scheduler.h"
 
+#include <algorithm>
+
+namespace {
+
+// Blocking tasks mostly sleep, so the pool may be much wider than the machine
+TaskPoolOptions BlockingIoOptions() {
+    return TaskPoolOptions{.workers = 4, .max_workers = 64, .spin_for = std::chrono::microseconds(0)};
+}
+
+}
+
 void DependentTask::Execute() {
     if (!scheduler->executed[id].exchange(true)) {
         scheduler->tasks[id]->execute();
-        
-        std::lock_guard<std::mutex> lock(scheduler->sched_mutex);
-        for (int child : scheduler->out_edges[id]) {
-            scheduler->in_degree[child]--;
-            if (scheduler->in_degree[child] == 0) {
-                scheduler->pool.EnqueueTask(std::move(std::make_shared<DependentTask>(child, scheduler)));
+
+        std::vector<int> ready;
+        {
+            auto lock = TimedLock(scheduler->sched_mutex, scheduler->sched_mutex_wait_ns);
+            for (int child : scheduler->out_edges[id]) {
+                scheduler->in_degree[child]--;
+                if (scheduler->in_degree[child] == 0) {
+                    ready.push_back(child);
+                }
             }
         }
+
+        scheduler->enqueue(ready);
     }
+
+    scheduler->finishTask();
 }
 
-void TTaskScheduler::executeAll() {
-    if (next_id <= 0) {
+void LevelChunkTask::Execute() {
+    for (const int* id = begin; id != end; ++id) {
+        if (!scheduler->executed[*id].exchange(true)) {
+            scheduler->tasks[*id]->execute();
+        }
+    }
+}
+
+void TTaskScheduler::registerExecutor(const std::string& name, const TaskPoolOptions& options) {
+    if (executor_names.contains(name)) {
+        throw std::runtime_error("executor is already registered: " + name);
+    }
+
+    pools.push_back(std::make_unique<TaskPool>(options));
+    executor_names.emplace(name, pools.size() - 1);
+}
+
+size_t TTaskScheduler::executorIndex(const std::string& name) {
+    auto it = executor_names.find(name);
+    if (it != executor_names.end()) {
+        return it->second;
+    }
+
+    if (name != "blocking-io") {
+        throw std::runtime_error("executor is not registered: " + name);
+    }
+
+    registerExecutor(name, BlockingIoOptions());
+    return pools.size() - 1;
+}
+
+ExecutorScope TTaskScheduler::on(ExecutorClass executor) {
+    return on(executor == ExecutorClass::Compute ? "compute" : "blocking-io");
+}
+
+ExecutorScope TTaskScheduler::on(const std::string& name) {
+    return ExecutorScope(*this, executorIndex(name));
+}
+
+// Ready tasks go to the pools of their executors, one batch per pool
+void TTaskScheduler::enqueue(const std::vector<int>& ids) {
+    if (ids.empty()) {
         return;
     }
 
+    if (pools.size() == 1) {
+        std::vector<std::shared_ptr<BaseTask>> batch;
+        batch.reserve(ids.size());
+        for (int id : ids) {
+            batch.push_back(std::make_shared<DependentTask>(id, this));
+        }
+
+        pools[0]->EnqueueBatch(batch);
+        return;
+    }
+
+    in_flight.fetch_add(ids.size(), std::memory_order_relaxed);
+
+    std::vector<std::vector<std::shared_ptr<BaseTask>>> batches(pools.size());
+    for (int id : ids) {
+        batches[executor_of.at(id)].push_back(std::make_shared<DependentTask>(id, this));
+    }
+
+    for (size_t executor = 0; executor < pools.size(); ++executor) {
+        if (!batches[executor].empty()) {
+            pools[executor]->EnqueueBatch(batches[executor]);
+        }
+    }
+}
+
+void TTaskScheduler::finishTask() {
+    if (pools.size() > 1 && in_flight.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard lock(done_mutex);
+        done_cv.notify_all();
+    }
+}
+
+void TTaskScheduler::waitDone() {
+    if (pools.size() == 1) {
+        pools[0]->WaitIdle();
+        return;
+    }
+
+    {
+        std::unique_lock lock(done_mutex);
+        done_cv.wait(lock, [this] {
+            return in_flight.load(std::memory_order_acquire) == 0;
+        });
+    }
+
+    // nothing new can be enqueued now, but a worker may still be finishing the pool's
+    // accounting for the last task, so stats() right after would undercount
+    for (auto& pool : pools) {
+        pool->WaitIdle();
+    }
+}
+
+void TTaskScheduler::enqueueRoots() {
+    std::vector<int> ready;
     {
-        std::lock_guard<std::mutex> lock(sched_mutex);
-        for (int id = 0; id < next_id; ++id) {
-            if (in_degree[id] == 0) {
-                pool.EnqueueTask(std::move(std::make_shared<DependentTask>(id, this)));
+        auto lock = TimedLock(sched_mutex, sched_mutex_wait_ns);
+        if (finalized) {
+            ready = roots;
+        } else {
+            for (int id = 0; id < next_id; ++id) {
+                if (in_degree[id] == 0) {
+                    ready.push_back(id);
+                }
             }
         }
     }
 
-    pool.WaitIdle();
+    enqueue(ready);
+}
+
+void TTaskScheduler::finalize() {
+    std::vector<int> remaining(next_id, 0);
+    std::vector<std::vector<int>> parents(next_id);
+
+    for (const auto& [id, children] : out_edges) {
+        if (id < 0 || id >= next_id) {
+            throw std::runtime_error("edge from a task that does not exist: " + std::to_string(id));
+        }
+
+        for (int child : children) {
+            if (child < 0 || child >= next_id) {
+                throw std::runtime_error("edge to a task that does not exist: " + std::to_string(child));
+            }
+
+            remaining[child]++;
+            parents[child].push_back(id);
+        }
+    }
+
+    // Kahn's algorithm, the level of a task is the longest path to it from a root
+    std::vector<int> order;
+    std::vector<int> level(next_id, 0);
+    order.reserve(next_id);
+
+    for (int id = 0; id < next_id; ++id) {
+        if (remaining[id] == 0) {
+            order.push_back(id);
+        }
+    }
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        int id = order[i];
+        auto edges = out_edges.find(id);
+        if (edges == out_edges.end()) {
+            continue;
+        }
+
+        for (int child : edges->second) {
+            level[child] = std::max(level[child], level[id] + 1);
+            if (--remaining[child] == 0) {
+                order.push_back(child);
+            }
+        }
+    }
+
+    if (order.size() != static_cast<size_t>(next_id)) {
+        throw std::runtime_error("task graph has a cycle");
+    }
+
+    for (int id = 0; id < next_id; ++id) {
+        std::vector<int> inputs = tasks.at(id)->dependencies();
+        std::sort(inputs.begin(), inputs.end());
+        std::sort(parents[id].begin(), parents[id].end());
+        if (inputs != parents[id]) {
+            throw std::runtime_error("edges of task " + std::to_string(id) + " do not match its promises");
+        }
+    }
+
+    std::vector<std::vector<int>> sets;
+    for (int id : order) {
+        if (static_cast<size_t>(level[id]) >= sets.size()) {
+            sets.resize(level[id] + 1);
+        }
+        sets[level[id]].push_back(id);
+    }
+
+    topo_order = std::move(order);
+    level_sets = std::move(sets);
+    roots = level_sets.empty() ? std::vector<int>{} : level_sets[0];
+    finalized = true;
+}
+
+// Runs one level at a time with a barrier in between, so tasks need no dependency countdown.
+// With several executors every level is split by executor and each part runs on its own pool
+void TTaskScheduler::executeLevels() {
+    if (!finalized) {
+        finalize();
+    }
+
+    std::vector<std::shared_ptr<BaseTask>> chunks;
+    auto enqueue_chunks = [&](const std::vector<int>& ids, TaskPool& pool) {
+        size_t chunks_count = std::min(ids.size(), pool.WorkersCount());
+        size_t chunk_size = (ids.size() + chunks_count - 1) / chunks_count;
+
+        chunks.clear();
+        for (size_t begin = 0; begin < ids.size(); begin += chunk_size) {
+            size_t end = std::min(begin + chunk_size, ids.size());
+            chunks.push_back(std::make_shared<LevelChunkTask>(ids.data() + begin, ids.data() + end, this));
+        }
+
+        pool.EnqueueBatch(chunks);
+    };
+
+    if (pools.size() == 1) {
+        for (const auto& level : level_sets) {
+            enqueue_chunks(level, *pools[0]);
+            pools[0]->WaitIdle();
+        }
+        return;
+    }
+
+    std::vector<std::vector<int>> parts(pools.size());
+    for (const auto& level : level_sets) {
+        for (auto& part : parts) {
+            part.clear();
+        }
+
+        for (int id : level) {
+            parts[executor_of.at(id)].push_back(id);
+        }
+
+        for (size_t executor = 0; executor < pools.size(); ++executor) {
+            if (!parts[executor].empty()) {
+                enqueue_chunks(parts[executor], *pools[executor]);
+            }
+        }
+
+        for (size_t executor = 0; executor < pools.size(); ++executor) {
+            if (!parts[executor].empty()) {
+                pools[executor]->WaitIdle();
+            }
+        }
+    }
+}
+
+void TTaskScheduler::executeAll(ExecutionEngine engine) {
+    if (next_id <= 0) {
+        return;
+    }
+
+    if (engine == ExecutionEngine::Levels) {
+        executeLevels();
+        return;
+    }
+
+    enqueueRoots();
+    waitDone();
+}
+
+SchedulerStats TTaskScheduler::stats() {
+    SchedulerStats result{
+        .pool = pools[0]->Stats(),
+        .sched_mutex_wait_ns = sched_mutex_wait_ns.load(std::memory_order_relaxed),
+        .executors = {},
+    };
+
+    for (const auto& [name, executor] : executor_names) {
+        if (executor != 0) {
+            result.executors.emplace(name, pools[executor]->Stats());
+        }
+    }
+
+    return result;
 }
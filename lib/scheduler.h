@@ -5,20 +5,70 @@
 #include <vector>
 #include <cinttypes>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <memory>
+#include <optional>
+#include <initializer_list>
+
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <thread>
 
 #include "any_type.h"
+#include "serialization.h"
+#include "task_key.h"
 #include "task_pool.h"
 
 class TTaskScheduler;
+class TaskRegistry;
+class ExecutorScope;
 
 class BaseSchedule {
 public:
     virtual void execute() = 0;
-    virtual AnyType result() = 0;
+    // The stored result, read in place so move-only results need no copy
+    virtual const AnyType& result() const = 0;
     virtual bool has_value() = 0;
     virtual ~BaseSchedule() = default;
+
+    // Hash of the computation (functor + inputs), nullopt if it can not be shared
+    virtual std::optional<size_t> fingerprint() const {
+        return std::nullopt;
+    }
+
+    virtual bool same_as(const BaseSchedule&) const {
+        return false;
+    }
+
+    // Ids of the tasks whose results are the inputs
+    virtual std::vector<int> dependencies() const = 0;
+
+    // Identifies the schedule type (functor + argument types) in a TaskRegistry
+    virtual size_t kind() const = 0;
+
+    // type_id of the result, promises of this task have to be of the same type
+    virtual size_t result_type_id() const = 0;
+
+    // Writes the inputs, returns false if some constant input is not serializable
+    virtual bool save(GraphWriter&) const {
+        return false;
+    }
+};
+
+using TaskMap = std::unordered_map<int, std::shared_ptr<BaseSchedule>>;
+
+enum class ExecutionEngine {
+    Dynamic,    // every task releases its children through the in_degree countdown
+    Levels,     // finalized level sets run one after another, each split into contiguous chunks
+};
+
+// Worker sets a task can be bound to, every executor has its own pool and queue
+enum class ExecutorClass {
+    Compute,    // the pool passed to the scheduler constructor, the default one
+    BlockingIo, // an elastic pool for tasks that block on io or sleep, created on first use
 };
 
 class DependentTask : public BaseTask {
@@ -30,9 +80,25 @@ public:
     void Execute();
 };
 
+class LevelChunkTask : public BaseTask {
+    const int* begin;
+    const int* end;
+    TTaskScheduler* scheduler;
+
+public:
+    LevelChunkTask(const int* begin_, const int* end_, TTaskScheduler* sch)
+        : begin(begin_), end(end_), scheduler(sch) {}
+    void Execute();
+};
+
 template<typename T>
 struct Promise {
-    explicit Promise(T val) noexcept : value(val), vertex(nullptr), promised(false), id(-1) {}
+    explicit Promise(const T& val) : vertex(nullptr), value(val), promised(false), id(-1) {}
+    explicit Promise(T&& val) : vertex(nullptr), value(std::move(val)), promised(false), id(-1) {}
+
+    template<typename... Args>
+    explicit Promise(std::in_place_t, Args&&... args)
+        : vertex(nullptr), value(std::in_place, std::forward<Args>(args)...), promised(false), id(-1) {}
 
     explicit Promise(BaseSchedule* vert, int id) noexcept : vertex(vert), id(id) {
         promised = true;
@@ -41,41 +107,194 @@ struct Promise {
     using value_type = T;
 
     BaseSchedule* vertex;
-    T value;
+    // empty for promised values, so T does not have to be default constructible
+    std::optional<T> value;
     bool promised;
     int id;
 };
 
+template<typename T>
+struct is_promise : std::false_type {};
+
+template<typename T>
+struct is_promise<Promise<T>> : std::true_type {};
+
+template<typename T>
+concept NotPromise = !is_promise<std::decay_t<T>>::value;
+
+// Reference to the input: the constant kept in the promise or the result of the promised task
+template<typename T>
+const T& promise_value(const Promise<T>& promise) {
+    if (promise.promised) {
+        if (!promise.vertex->has_value()) {
+            throw std::runtime_error("Promised vertex has no value");
+        }
+
+        return any_cast_ref<T>(promise.vertex->result());
+    }
+
+    return *promise.value;
+}
+
+// Promise for a schedule input: promises are passed on, constants are built in place.
+// Returned as a prvalue, so it initializes the schedule member without another move
+template<typename T, typename Input>
+Promise<T> as_promise(Input&& input) {
+    if constexpr (is_promise<std::decay_t<Input>>::value) {
+        return std::forward<Input>(input);
+    } else {
+        return Promise<T>(std::in_place, std::forward<Input>(input));
+    }
+}
+
+// Throws if the promised task produces something other than T, before the mismatch
+// could surface as a bad cast in the middle of a run
+template<typename T>
+void check_promise_type(const Promise<T>& promise) {
+    if (promise.promised && promise.vertex && promise.vertex->result_type_id() != type_id<my_decay_t<T>>()) {
+        throw std::runtime_error("promise type does not match the result of task " + std::to_string(promise.id));
+    }
+}
+
+template<typename T>
+std::optional<size_t> promise_hash(const Promise<T>& promise) {
+    if (promise.promised) {
+        return std::hash<int>{}(promise.id);
+    }
+
+    if constexpr (HashComparable<T>) {
+        size_t seed = std::hash<T>{}(*promise.value);
+        hash_combine(seed, 1);
+        return seed;
+    }
+
+    return std::nullopt;
+}
+
+template<typename T>
+bool same_promise(const Promise<T>& left, const Promise<T>& right) {
+    if (left.promised || right.promised) {
+        return left.promised == right.promised && left.id == right.id;
+    }
+
+    if constexpr (HashComparable<T>) {
+        return *left.value == *right.value;
+    }
+
+    return false;
+}
+
+template<typename T>
+void collect_dependency(std::vector<int>& ids, const Promise<T>& promise) {
+    if (promise.promised) {
+        ids.push_back(promise.id);
+    }
+}
+
+template<typename T>
+bool save_promise(GraphWriter& writer, const Promise<T>& promise) {
+    if (promise.promised) {
+        writer.write<uint8_t>(1);
+        writer.write<int32_t>(promise.id);
+        return true;
+    }
+
+    if constexpr (Serializable<T>) {
+        writer.write<uint8_t>(0);
+        writer.write(*promise.value);
+        return true;
+    }
+
+    return false;
+}
+
+template<typename T>
+Promise<T> load_promise(GraphReader& reader, const TaskMap& tasks) {
+    if (reader.read<uint8_t>() == 1) {
+        int id = reader.read<int32_t>();
+        auto it = tasks.find(id);
+        if (it == tasks.end()) {
+            throw std::runtime_error("promise refers to a task that is not loaded");
+        }
+
+        return Promise<T>(it->second.get(), id);
+    }
+
+    if constexpr (Serializable<T>) {
+        return Promise<T>(reader.read<T>());
+    } else {
+        throw std::runtime_error("input type is not serializable");
+    }
+}
+
 template<typename Functor, typename T>
 class ScheduleOfOne : public BaseSchedule {
     Functor func_;
     Promise<T> arg_;
     AnyType result_;
 public:
-    ScheduleOfOne(Functor func, const Promise<T>& arg) noexcept : 
-        arg_(arg), func_(func) {}
+    using result_type = std::decay_t<std::invoke_result_t<Functor&, const T&>>;
+
+    template<typename Input>
+    ScheduleOfOne(Functor func, Input&& arg) :
+        func_(std::move(func)), arg_(as_promise<T>(std::forward<Input>(arg))) {
+        check_promise_type(arg_);
+    }
 
     void execute() override {
-        using type = typename Promise<T>::value_type;
+        result_.emplace_with<result_type>([this]() -> result_type {
+            return func_(promise_value(arg_));
+        });
+    }
 
-        if(arg_.promised) {
-            if (!arg_.vertex->has_value()) {
-                throw std::runtime_error("Promised vertex has no value");
-            }
+    const AnyType& result() const override {
+        return result_;
+    }
+
+    bool has_value() override {
+        return result_.has_value();
+    }
 
-            type data = any_cast<type>(arg_.vertex->result());
-            result_ = func_(data);
+    std::optional<size_t> fingerprint() const override {
+        if constexpr (!is_shareable_functor_v<Functor>) {
+            return std::nullopt;
         } else {
-            result_ = func_(arg_.value);
+            auto arg_hash = promise_hash(arg_);
+            if (!arg_hash) {
+                return std::nullopt;
+            }
+
+            size_t seed = type_id<ScheduleOfOne>();
+            hash_combine(seed, *arg_hash);
+            return seed;
         }
     }
 
-    AnyType result() override {
-        return result_.clone();
+    bool same_as(const BaseSchedule& other) const override {
+        auto* that = dynamic_cast<const ScheduleOfOne*>(&other);
+        return that && same_functor(func_, that->func_) && same_promise(arg_, that->arg_);
     }
 
-    bool has_value() override {
-        return result_.has_value();
+    std::vector<int> dependencies() const override {
+        std::vector<int> ids;
+        collect_dependency(ids, arg_);
+        return ids;
+    }
+
+    size_t kind() const override {
+        return type_id<ScheduleOfOne>();
+    }
+
+    size_t result_type_id() const override {
+        return type_id<result_type>();
+    }
+
+    bool save(GraphWriter& writer) const override {
+        return save_promise(writer, arg_);
+    }
+
+    static std::shared_ptr<BaseSchedule> load(Functor func, GraphReader& reader, const TaskMap& tasks) {
+        return std::make_shared<ScheduleOfOne>(std::move(func), load_promise<T>(reader, tasks));
     }
 };
 
@@ -86,76 +305,152 @@ class ScheduleOfTwo : public BaseSchedule {
     Promise<U> arg_right_;
     AnyType result_;
 public:
-    ScheduleOfTwo(Functor func, const Promise<T>& arg_left, const Promise<U>& arg_right) noexcept :
-        func_(func), arg_left_(arg_left), arg_right_(arg_right) {}
+    using result_type = std::decay_t<std::invoke_result_t<Functor&, const T&, const U&>>;
+
+    template<typename Left, typename Right>
+    ScheduleOfTwo(Functor func, Left&& arg_left, Right&& arg_right) :
+        func_(std::move(func)),
+        arg_left_(as_promise<T>(std::forward<Left>(arg_left))),
+        arg_right_(as_promise<U>(std::forward<Right>(arg_right))) {
+        check_promise_type(arg_left_);
+        check_promise_type(arg_right_);
+    }
 
     void execute() override {
-        T left_arg;
-        U right_arg;
+        result_.emplace_with<result_type>([this]() -> result_type {
+            return func_(promise_value(arg_left_), promise_value(arg_right_));
+        });
+    }
 
-        if(arg_left_.promised) {
-            if(!arg_left_.vertex->has_value()) {
-                throw std::runtime_error("not provided value for left arg");
-            }
+    const AnyType& result() const override {
+        return result_;
+    }
 
-            left_arg = any_cast<T>(arg_left_.vertex->result());
-        } else {
-            left_arg = arg_left_.value;
-        }
+    bool has_value() override {
+        return result_.has_value();
+    }
 
-        if(arg_right_.promised) {
-            if(!arg_right_.vertex->has_value()) {
-                throw std::runtime_error("not provided value for left arg");
+    std::optional<size_t> fingerprint() const override {
+        if constexpr (!is_shareable_functor_v<Functor>) {
+            return std::nullopt;
+        } else {
+            auto left_hash = promise_hash(arg_left_);
+            auto right_hash = promise_hash(arg_right_);
+            if (!left_hash || !right_hash) {
+                return std::nullopt;
             }
 
-            right_arg = any_cast<U>(arg_right_.vertex->result());
-        } else {
-            right_arg = arg_right_.value;
+            size_t seed = type_id<ScheduleOfTwo>();
+            hash_combine(seed, *left_hash);
+            hash_combine(seed, *right_hash);
+            return seed;
         }
+    }
 
-        result_ = func_(left_arg, right_arg);
+    bool same_as(const BaseSchedule& other) const override {
+        auto* that = dynamic_cast<const ScheduleOfTwo*>(&other);
+        return that && same_functor(func_, that->func_) &&
+            same_promise(arg_left_, that->arg_left_) && same_promise(arg_right_, that->arg_right_);
     }
 
-    AnyType result() override {
-        return result_.clone();
+    std::vector<int> dependencies() const override {
+        std::vector<int> ids;
+        collect_dependency(ids, arg_left_);
+        collect_dependency(ids, arg_right_);
+        return ids;
     }
 
-    bool has_value() override {
-        return result_.has_value();
+    size_t kind() const override {
+        return type_id<ScheduleOfTwo>();
+    }
+
+    size_t result_type_id() const override {
+        return type_id<result_type>();
+    }
+
+    bool save(GraphWriter& writer) const override {
+        return save_promise(writer, arg_left_) && save_promise(writer, arg_right_);
+    }
+
+    static std::shared_ptr<BaseSchedule> load(Functor func, GraphReader& reader, const TaskMap& tasks) {
+        Promise<T> left = load_promise<T>(reader, tasks);
+        Promise<U> right = load_promise<U>(reader, tasks);
+        return std::make_shared<ScheduleOfTwo>(std::move(func), std::move(left), std::move(right));
     }
 };
 
 template<typename Class, typename RetType, typename Arg>
 class ScheduleOfOneMethod : public BaseSchedule {
+    using arg_type = std::decay_t<Arg>;
+
     RetType (Class::*func_)(Arg);
-    Promise<Arg> arg_;
+    Promise<arg_type> arg_;
     Class obj_;
     AnyType result_;
 public:
-    ScheduleOfOneMethod(RetType (Class::*func)(Arg), Class obj, const Promise<Arg>& arg) noexcept :
-        func_(func), obj_(obj), arg_(arg) {}
+    using result_type = std::decay_t<RetType>;
+
+    template<typename Input>
+    ScheduleOfOneMethod(RetType (Class::*func)(Arg), Class obj, Input&& arg) :
+        func_(func), arg_(as_promise<arg_type>(std::forward<Input>(arg))), obj_(std::move(obj)) {
+        check_promise_type(arg_);
+    }
 
     void execute() override {
-        using type = typename Promise<Arg>::value_type;
+        result_.emplace_with<result_type>([this]() -> result_type {
+            return (obj_.*func_)(promise_value(arg_));
+        });
+    }
 
-        if(arg_.promised) {
-            if (!arg_.vertex->has_value()) {
-                throw std::runtime_error("Promised vertex has no value");
-            }
+    const AnyType& result() const override {
+        return result_;
+    }
+
+    bool has_value() override {
+        return result_.has_value();
+    }
 
-            type data = any_cast<type>(arg_.vertex->result());
-            result_ = (obj_.*func_)(data);
+    std::optional<size_t> fingerprint() const override {
+        if constexpr (!is_shareable_functor_v<Class>) {
+            return std::nullopt;
         } else {
-            result_ = (obj_.*func_)(arg_.value);
+            auto arg_hash = promise_hash(arg_);
+            if (!arg_hash) {
+                return std::nullopt;
+            }
+
+            size_t seed = type_id<ScheduleOfOneMethod>();
+            hash_combine(seed, *arg_hash);
+            return seed;
         }
     }
 
-    AnyType result() override {
-        return result_.clone();
+    bool same_as(const BaseSchedule& other) const override {
+        auto* that = dynamic_cast<const ScheduleOfOneMethod*>(&other);
+        return that && func_ == that->func_ && same_functor(obj_, that->obj_) && same_promise(arg_, that->arg_);
     }
 
-    bool has_value() override {
-        return result_.has_value();
+    std::vector<int> dependencies() const override {
+        std::vector<int> ids;
+        collect_dependency(ids, arg_);
+        return ids;
+    }
+
+    size_t kind() const override {
+        return type_id<ScheduleOfOneMethod>();
+    }
+
+    size_t result_type_id() const override {
+        return type_id<result_type>();
+    }
+
+    bool save(GraphWriter& writer) const override {
+        return save_promise(writer, arg_);
+    }
+
+    static std::shared_ptr<BaseSchedule> load(
+            RetType (Class::*func)(Arg), Class obj, GraphReader& reader, const TaskMap& tasks) {
+        return std::make_shared<ScheduleOfOneMethod>(func, std::move(obj), load_promise<arg_type>(reader, tasks));
     }
 };
 
@@ -163,97 +458,190 @@ class TTaskScheduler {
 private:
     std::unordered_map<int, std::vector<int>> out_edges;
     std::unordered_map<int, std::atomic<bool>> executed;
-    std::unordered_map<int, std::shared_ptr<BaseSchedule>> tasks;
+    TaskMap tasks;
     std::unordered_map<int, std::atomic<int>> in_degree;
 
+    // fingerprint -> ids of the tasks with it, filled only when deduplication is on
+    std::unordered_multimap<size_t, int> shared_tasks;
+    bool deduplicate = false;
+
+    // filled by finalize() and dropped by the next add
+    std::vector<int> topo_order;
+    std::vector<std::vector<int>> level_sets;
+    std::vector<int> roots;
+    bool finalized = false;
+
     std::mutex sched_mutex;
-    TaskPool pool;
+    std::atomic<uint64_t> sched_mutex_wait_ns = 0;
 
     int next_id = 0;
-    
-public:
-    TTaskScheduler() : pool(4) {}
-    TTaskScheduler(size_t workes_count) : pool(workes_count) {}
 
-    template<typename Functor, typename T>
-    int add(Functor func, T val) {
-        tasks[next_id] = 
-            std::make_shared<ScheduleOfOne<Functor,T>>(ScheduleOfOne<Functor, T>(func, Promise<T>(val)));
-        in_degree[next_id] = 0;
+    // executor name -> index in pools, "compute" is 0
+    std::unordered_map<std::string, size_t> executor_names;
+    std::unordered_map<int, size_t> executor_of;
+    // executor of the tasks being added, switched by ExecutorScope
+    size_t adding_executor = 0;
+
+    // tasks enqueued and not finished yet, tracked only with several executors
+    // because WaitIdle of one pool does not see the tasks it hands to another one
+    std::atomic<size_t> in_flight = 0;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+
+    // declared last so the workers are joined before the state they touch is destroyed
+    std::vector<std::unique_ptr<TaskPool>> pools;
+
+    int findShared(const BaseSchedule& task) const {
+        auto key = task.fingerprint();
+        if (!key) {
+            return -1;
+        }
 
-        next_id++;
-        return next_id - 1;
+        auto [begin, end] = shared_tasks.equal_range(*key);
+        for (auto it = begin; it != end; ++it) {
+            if (executor_of.at(it->second) == adding_executor && task.same_as(*tasks.at(it->second))) {
+                return it->second;
+            }
+        }
+
+        return -1;
     }
 
-    template<typename Functor, typename T, typename U = T>
-    int add(Functor func, T val_left, U val_right) {
-        tasks[next_id] = 
-            std::make_shared<ScheduleOfTwo<Functor,T,U>>(ScheduleOfTwo<Functor, T, U>(func, Promise<T>(val_left), Promise<U>(val_right)));
+    int insertTask(std::shared_ptr<BaseSchedule> task, std::initializer_list<int> dependencies) {
+        for (int dependency : dependencies) {
+            if (tasks.find(dependency) == tasks.end()) {
+                throw std::runtime_error("promise refers to a task that does not exist");
+            }
+        }
+
+        if (deduplicate) {
+            int existing = findShared(*task);
+            if (existing != -1) {
+                return existing;
+            }
+
+            if (auto key = task->fingerprint()) {
+                shared_tasks.emplace(*key, next_id);
+            }
+        }
+
+        tasks[next_id] = std::move(task);
         in_degree[next_id] = 0;
+        executed[next_id] = false;
+        executor_of[next_id] = adding_executor;
+        finalized = false;
+
+        for (int dependency : dependencies) {
+            out_edges[dependency].push_back(next_id);
+            in_degree[next_id] += 1;
+        }
 
         next_id++;
         return next_id - 1;
     }
 
-    template<typename Functor, typename T>
-    int add(Functor func, Promise<T> promise) {
-        tasks[next_id] = 
-            std::make_shared<ScheduleOfOne<Functor, T>>(ScheduleOfOne<Functor, T>(func, promise));
+    template<typename... Args>
+    int addOn(size_t executor, Args&&... args) {
+        size_t previous = std::exchange(adding_executor, executor);
+        try {
+            int id = add(std::forward<Args>(args)...);
+            adding_executor = previous;
+            return id;
+        } catch (...) {
+            adding_executor = previous;
+            throw;
+        }
+    }
 
-        out_edges[promise.id].push_back(next_id);
-        in_degree[next_id] += 1;
+    size_t executorIndex(const std::string& name);
+    void enqueue(const std::vector<int>& ids);
+    void finishTask();
+    void waitDone();
+    void enqueueRoots();
+    void executeLevels();
+    void loadFrom(const std::string& path, const TaskRegistry& registry);
 
-        next_id++;
-        return next_id - 1;
+public:
+    // At least the 4 workers of the original fixed pool, so a few sleeping tasks still run side by side
+    TTaskScheduler() : TTaskScheduler(std::max<size_t>(4, std::thread::hardware_concurrency())) {}
+    TTaskScheduler(size_t workes_count)
+        : TTaskScheduler(TaskPoolOptions{.workers = workes_count, .max_workers = workes_count}) {}
+    TTaskScheduler(const TaskPoolOptions& options) {
+        pools.push_back(std::make_unique<TaskPool>(options));
+        executor_names.emplace("compute", 0);
     }
 
-    template<typename Functor, typename T, typename U = T>
-    int add(Functor func, T val, Promise<U> promise) {
-        tasks[next_id] = 
-            std::make_shared<ScheduleOfTwo<Functor,T,U>>(ScheduleOfTwo<Functor, T, U>(func, Promise<T>(val), promise));
+    // Creates a named executor with its own workers. "blocking-io" can be registered before the
+    // first on(ExecutorClass::BlockingIo) to change its options. Not allowed while tasks run
+    void registerExecutor(const std::string& name, const TaskPoolOptions& options);
 
-        out_edges[promise.id].push_back(next_id);
-        in_degree[next_id] += 1;
+    // Tasks added through the returned scope run on that executor,
+    // edges between tasks of different executors work as usual:
+    //     scheduler.on(ExecutorClass::BlockingIo).add(read_file, path)
+    ExecutorScope on(ExecutorClass executor);
+    ExecutorScope on(const std::string& name);
 
-        next_id++;
-        return next_id - 1;
+    // When enabled, adding a task equal to an already added one (same functor, same
+    // constant inputs or same upstream ids) returns the id of the existing task
+    void enableDeduplication(bool enabled = true) {
+        deduplicate = enabled;
     }
 
-    template<typename Functor, typename T, typename U = T>
-    int add(Functor func, Promise<T> promise_right, Promise<U> promise_left) {
-        tasks[next_id] = 
-            std::make_shared<ScheduleOfTwo<Functor, T, U>>(ScheduleOfTwo<Functor, T, U>(func, promise_right, promise_left));
-        
-        out_edges[promise_left.id].push_back(next_id);
-        out_edges[promise_right.id].push_back(next_id);
-        in_degree[next_id] += 2;
+    // Constant inputs are forwarded and constructed once, in place inside the task, so rvalues
+    // (including move-only values) are moved exactly once. Tasks receive their inputs as
+    // const references and results are built in place
 
-        next_id++;
-        return next_id - 1;
+    template<typename Functor, NotPromise T>
+    requires (!std::is_member_function_pointer_v<Functor>)
+    int add(Functor func, T&& val) {
+        using arg_type = std::decay_t<T>;
+        return insertTask(std::make_shared<ScheduleOfOne<Functor, arg_type>>(std::move(func), std::forward<T>(val)), {});
     }
 
-    template<typename Class, typename RetType, typename Arg>
-    int add(RetType (Class::*func)(Arg), Class obj, Arg val) {
-        tasks[next_id] = 
-            std::make_shared<ScheduleOfOneMethod<Class, RetType, Arg>>(
-                ScheduleOfOneMethod<Class, RetType, Arg>(func, obj, Promise<Arg>(val)));
-        in_degree[next_id] = 0;
+    template<typename Functor, NotPromise T, NotPromise U>
+    requires (!std::is_member_function_pointer_v<Functor>)
+    int add(Functor func, T&& val_left, U&& val_right) {
+        using left_type = std::decay_t<T>;
+        using right_type = std::decay_t<U>;
+        return insertTask(std::make_shared<ScheduleOfTwo<Functor, left_type, right_type>>(
+            std::move(func), std::forward<T>(val_left), std::forward<U>(val_right)), {});
+    }
 
-        next_id++;
-        return next_id - 1;
+    template<typename Functor, typename T>
+    int add(Functor func, Promise<T> promise) {
+        int id = promise.id;
+        return insertTask(std::make_shared<ScheduleOfOne<Functor, T>>(std::move(func), std::move(promise)), {id});
     }
 
-    template<typename Class, typename RetType, typename Arg>
-    int add(RetType (Class::*func)(Arg), Class obj, Promise<Arg> promise) {
-        tasks[next_id] = 
-            std::make_shared<ScheduleOfOneMethod<Class, RetType, Arg>>(
-                ScheduleOfOneMethod<Class, RetType, Arg>(func, obj, promise));
+    template<typename Functor, NotPromise T, typename U>
+    requires (!std::is_member_function_pointer_v<Functor>)
+    int add(Functor func, T&& val, Promise<U> promise) {
+        using arg_type = std::decay_t<T>;
+        int id = promise.id;
+        return insertTask(std::make_shared<ScheduleOfTwo<Functor, arg_type, U>>(
+            std::move(func), std::forward<T>(val), std::move(promise)), {id});
+    }
 
-        out_edges[promise.id].push_back(next_id);
-        in_degree[next_id] += 1;
+    template<typename Functor, typename T, typename U = T>
+    int add(Functor func, Promise<T> promise_right, Promise<U> promise_left) {
+        int left_id = promise_left.id;
+        int right_id = promise_right.id;
+        return insertTask(std::make_shared<ScheduleOfTwo<Functor, T, U>>(
+            std::move(func), std::move(promise_right), std::move(promise_left)), {left_id, right_id});
+    }
 
-        next_id++;
-        return next_id - 1;
+    template<typename Class, typename RetType, typename Arg, NotPromise V>
+    requires std::constructible_from<std::decay_t<Arg>, V>
+    int add(RetType (Class::*func)(Arg), Class obj, V&& val) {
+        return insertTask(std::make_shared<ScheduleOfOneMethod<Class, RetType, Arg>>(
+            func, std::move(obj), std::forward<V>(val)), {});
+    }
+
+    template<typename Class, typename RetType, typename Arg>
+    int add(RetType (Class::*func)(Arg), Class obj, Promise<std::decay_t<Arg>> promise) {
+        int id = promise.id;
+        return insertTask(std::make_shared<ScheduleOfOneMethod<Class, RetType, Arg>>(
+            func, std::move(obj), std::move(promise)), {id});
     }
 
     template<typename T>
@@ -265,26 +653,64 @@ public:
         return Promise<T>(tasks[id].get(), id);
     }
 
+    // The reference stays valid while the scheduler lives and the graph is not executed again
     template<typename T>
-    auto getResult(int id) {
+    const my_decay_t<T>& getResult(int id) {
         if (tasks.find(id) == tasks.end()) {
             throw std::runtime_error("Invalid task id");
         }
 
-        {
-            std::lock_guard<std::mutex> lock(sched_mutex);
-            for (int i = 0; i < next_id; ++i) {
-                if (in_degree[i] == 0) {
-                    pool.EnqueueTask(std::move(std::make_shared<DependentTask>(i, this)));
-                }
-            }
-        }
+        enqueueRoots();
+        waitDone();
+        return any_cast_ref<T>(tasks[id]->result());
+    }
+
+    void executeAll(ExecutionEngine engine = ExecutionEngine::Dynamic);
 
-        pool.WaitIdle();
-        return any_cast<T>(tasks[id]->result());
+    // Checks that the edges point at existing tasks and match the promised inputs of every task and
+    // that the graph has no cycles, then precomputes the topological order and level sets so later
+    // runs skip the root scan. Promise types are checked when a task is added or loaded.
+    // Throws std::runtime_error on an invalid graph
+    void finalize();
+
+    // Snapshot of the pool counters and histograms, cheap enough to poll in production
+    SchedulerStats stats();
+
+    bool isFinalized() const {
+        return finalized;
+    }
+
+    const std::vector<int>& topologicalOrder() const {
+        return topo_order;
+    }
+
+    // level_sets[k] holds the tasks whose longest path from a root has k edges
+    const std::vector<std::vector<int>>& levels() const {
+        return level_sets;
     }
 
-    void executeAll();
+    // Writes the topology (task kinds, constant inputs, edges) to a binary file,
+    // every task functor has to be registered in the registry
+    void save(const std::string& path, const TaskRegistry& registry) const;
+    // Restores a topology written by save into an empty scheduler, rebinding functors by name,
+    // and finalizes it
+    void load(const std::string& path, const TaskRegistry& registry);
 
     friend DependentTask;
+    friend LevelChunkTask;
+    friend ExecutorScope;
+};
+
+// Adds tasks bound to one executor, returned by TTaskScheduler::on
+class ExecutorScope {
+    TTaskScheduler& scheduler;
+    size_t executor;
+
+public:
+    ExecutorScope(TTaskScheduler& sch, size_t index) : scheduler(sch), executor(index) {}
+
+    template<typename... Args>
+    int add(Args&&... args) {
+        return scheduler.addOn(executor, std::forward<Args>(args)...);
+    }
 };
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+template<typename T>
+concept TriviallySerializable = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>;
+
+template<typename T>
+struct is_serializable : std::bool_constant<TriviallySerializable<T>> {};
+
+template<>
+struct is_serializable<std::string> : std::true_type {};
+
+template<typename T>
+struct is_serializable<std::vector<T>> : std::bool_constant<TriviallySerializable<T>> {};
+
+template<typename T>
+concept Serializable = is_serializable<T>::value;
+
+// Appends values to a flat native-endian byte buffer
+class GraphWriter {
+    std::string buffer_;
+
+public:
+    template<TriviallySerializable T>
+    void write(const T& value) {
+        buffer_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void write(const std::string& value) {
+        write<uint32_t>(value.size());
+        buffer_.append(value);
+    }
+
+    template<TriviallySerializable T>
+    void write(const std::vector<T>& value) {
+        write<uint32_t>(value.size());
+        buffer_.append(reinterpret_cast<const char*>(value.data()), value.size() * sizeof(T));
+    }
+
+    void writeBytes(std::string_view bytes) {
+        buffer_.append(bytes);
+    }
+
+    const std::string& data() const {
+        return buffer_;
+    }
+
+    size_t size() const {
+        return buffer_.size();
+    }
+};
+
+// Reads values back from a buffer produced by GraphWriter, throws on truncated input
+class GraphReader {
+    const char* pos_;
+    const char* end_;
+
+    const char* take(size_t size) {
+        if (static_cast<size_t>(end_ - pos_) < size) {
+            throw std::runtime_error("truncated graph file");
+        }
+
+        const char* result = pos_;
+        pos_ += size;
+        return result;
+    }
+
+public:
+    GraphReader(std::string_view data) : pos_(data.data()), end_(data.data() + data.size()) {}
+
+    template<typename T>
+    T read() {
+        if constexpr (std::same_as<T, std::string>) {
+            uint32_t size = read<uint32_t>();
+            return std::string(take(size), size);
+        } else if constexpr (TriviallySerializable<T>) {
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        } else {
+            using value_type = typename T::value_type;
+            uint32_t size = read<uint32_t>();
+            // bounds are checked before allocating, a corrupted size must not allocate gigabytes
+            const char* bytes = take(size_t(size) * sizeof(value_type));
+            T value(size);
+            if (size > 0) {
+                std::memcpy(value.data(), bytes, size * sizeof(value_type));
+            }
+            return value;
+        }
+    }
+
+    std::string_view readBytes(size_t size) {
+        return std::string_view(take(size), size);
+    }
+
+    bool empty() const {
+        return pos_ == end_;
+    }
+
+    size_t remaining() const {
+        return end_ - pos_;
+    }
+};
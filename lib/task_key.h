@@ -0,0 +1,32 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+template<typename T>
+concept HashComparable = requires(const T& a, const T& b) {
+    { std::hash<T>{}(a) } -> std::convertible_to<size_t>;
+    { a == b } -> std::convertible_to<bool>;
+};
+
+inline void hash_combine(size_t& seed, size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+// Stateless functors (captureless lambdas) of the same type always compute the same thing,
+// anything else has to provide operator== to be shared.
+template<typename Functor>
+constexpr bool is_shareable_functor_v = std::is_empty_v<Functor> || std::equality_comparable<Functor>;
+
+template<typename Functor>
+bool same_functor(const Functor& left, const Functor& right) {
+    if constexpr (std::is_empty_v<Functor>) {
+        return true;
+    } else if constexpr (std::equality_comparable<Functor>) {
+        return left == right;
+    } else {
+        return false;
+    }
+}
@@ -1,17 +1,183 @@
 #include "task_pool.h"
 
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include <pthread.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+
+thread_local const TaskPool* current_pool = nullptr;
+thread_local size_t current_node = 0;
+thread_local WorkerMetrics* current_metrics = nullptr;
+thread_local size_t enqueue_tick = 0;
+
+constexpr size_t kMaxBackoff = 64;
+
+void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+int64_t ThreadCpuNs(clockid_t clock) {
+    timespec time{};
+    if (clock_gettime(clock, &time) != 0) {
+        return 0;
+    }
+    return static_cast<int64_t>(time.tv_sec) * 1'000'000'000 + time.tv_nsec;
+}
+
+// Whether the thread is running or waiting for a cpu. A preempted CPU-bound task makes no
+// progress either, but another worker would only compete with it for the same cpus
+bool ThreadRunnable(int tid) {
+#ifdef __linux__
+    if (tid == 0) {
+        return false;
+    }
+
+    std::ifstream file("/proc/self/task/" + std::to_string(tid) + "/stat");
+    std::string stat;
+    std::getline(file, stat);
+
+    // the state follows the command name, which is in parentheses and may contain them
+    size_t end = stat.rfind(')');
+    return end != std::string::npos && end + 2 < stat.size() && stat[end + 2] == 'R';
+#else
+    (void)tid;
+    return false;
+#endif
+}
+
+void AddMetrics(TaskPoolStats& stats, const WorkerMetrics& metrics) {
+    stats.tasks_executed += metrics.tasks_executed.load(std::memory_order_relaxed);
+    stats.steals += metrics.steals.load(std::memory_order_relaxed);
+    stats.enqueues += metrics.enqueues.load(std::memory_order_relaxed);
+    stats.idle_parks += metrics.idle_parks.load(std::memory_order_relaxed);
+    stats.queue_mutex_wait_ns += metrics.queue_mutex_wait_ns.load(std::memory_order_relaxed);
+    stats.run_time.Merge(metrics.run_time.Snapshot());
+    stats.ready_latency.Merge(metrics.ready_latency.Snapshot());
+}
+
+TaskPoolOptions Normalize(TaskPoolOptions options) {
+    if (options.workers == 0) {
+        options.workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    options.metrics_sample_every = std::max<size_t>(options.metrics_sample_every, 1);
+
+    if (options.max_workers == 0) {
+        options.max_workers = options.workers;
+    }
+
+    options.max_workers = std::max(options.max_workers, options.workers);
+    return options;
+}
+
+}
+
+TaskPool::TaskPool(const TaskPoolOptions& pool_options)
+    : options(Normalize(pool_options))
+    , topology(options.affinity == AffinityPolicy::None ? CpuTopology::Flat() : CpuTopology::Detect()) {
+    size_t nodes_count = options.affinity == AffinityPolicy::None ? 1 : topology.NodesCount();
+    for (size_t node = 0; node < nodes_count; ++node) {
+        nodes.push_back(std::make_unique<NodeQueue>());
+        nodes.back()->victims = topology.Neighbours(node);
+    }
+
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    for (size_t i = 0; i < options.workers; i++) {
+        SpawnWorker();
+    }
+
+    if (options.max_workers > options.workers) {
+        supervisor = std::thread([this]() { Supervise(); });
+    }
+}
+
+size_t TaskPool::WorkersCount() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    return alive;
+}
+
+WorkerMetrics& TaskPool::CurrentMetrics() {
+    return current_pool == this ? *current_metrics : external_metrics;
+}
+
+TaskPoolStats TaskPool::Stats() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    TaskPoolStats stats = retired_metrics;
+    AddMetrics(stats, external_metrics);
+    stats.workers = alive;
+    stats.queue_high_water = queue_high_water;
+    stats.pin_failures = pin_failures.load(std::memory_order_relaxed);
+
+    for (const auto& metrics : worker_metrics) {
+        AddMetrics(stats, *metrics);
+    }
+
+    return stats;
+}
+
 void TaskPool::EnqueueTask(std::shared_ptr<BaseTask>&& task) {
+    WorkerMetrics& metrics = CurrentMetrics();
+    task->ready_at = {};
+    if (++enqueue_tick % options.metrics_sample_every == 0) {
+        task->ready_at = std::chrono::steady_clock::now();
+    }
+
+    NodeQueue* wake = nullptr;
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        tasks.push(std::move(task));
+        auto lock = TimedLock(queue_mutex, metrics.queue_mutex_wait_ns);
+        wake = PushTask(std::move(task), metrics);
+    }
+
+    if (wake) {
+        wake->cv_task.notify_one();
+    }
+}
+
+void TaskPool::EnqueueBatch(std::span<std::shared_ptr<BaseTask>> batch) {
+    WorkerMetrics& metrics = CurrentMetrics();
+    std::chrono::steady_clock::time_point now;
+    for (auto& task : batch) {
+        task->ready_at = {};
+        if (++enqueue_tick % options.metrics_sample_every == 0) {
+            if (now == std::chrono::steady_clock::time_point{}) {
+                now = std::chrono::steady_clock::now();
+            }
+            task->ready_at = now;
+        }
+    }
+
+    std::vector<NodeQueue*> wake;
+    {
+        auto lock = TimedLock(queue_mutex, metrics.queue_mutex_wait_ns);
+        for (auto& task : batch) {
+            if (NodeQueue* node = PushTask(std::move(task), metrics)) {
+                wake.push_back(node);
+            }
+        }
+    }
+
+    for (NodeQueue* node : wake) {
+        node->cv_task.notify_one();
     }
-    cv_task.notify_one();
 }
 
 void TaskPool::WaitIdle() {
     std::unique_lock<std::mutex> lock(queue_mutex);
     cv_idle.wait(lock, [this]() {
-        return tasks.empty() && tasks_in_progress == 0;
+        return queued == 0 && tasks_in_progress == 0;
     });
 }
 
@@ -21,7 +187,15 @@ void TaskPool::Stop() {
         stop = true;
     }
 
-    cv_task.notify_all();
+    cv_supervisor.notify_all();
+    if (supervisor.joinable()) {
+        supervisor.join();
+    }
+
+    for (auto& node : nodes) {
+        node->cv_task.notify_all();
+    }
+
     for (auto& worker : workers) {
         if (worker.joinable()) {
             worker.join();
@@ -29,31 +203,308 @@ void TaskPool::Stop() {
     }
 }
 
-void TaskPool::InitWorker() {
-    while(true) {
-        std::shared_ptr<BaseTask> task;
+// Must be called under queue_mutex
+void TaskPool::SpawnWorker() {
+    // join the workers that have retired since the last spawn
+    std::erase_if(workers, [this](std::thread& worker) {
+        if (std::find(retired.begin(), retired.end(), worker.get_id()) == retired.end()) {
+            return false;
+        }
 
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            cv_task.wait(lock, [this]() {
-                return stop || !tasks.empty();
+        worker.join();
+        return true;
+    });
+    retired.clear();
+
+    size_t index = spawned++;
+    size_t node = index % nodes.size();
+    const auto& node_cpus = topology.node_cpus[node];
+
+    std::vector<int> cpus;
+    if (options.affinity == AffinityPolicy::Cpu) {
+        cpus.push_back(node_cpus[(index / nodes.size()) % node_cpus.size()]);
+    } else if (options.affinity == AffinityPolicy::Node) {
+        cpus = node_cpus;
+    }
+
+    worker_metrics.push_back(std::make_unique<WorkerMetrics>());
+    WorkerMetrics* metrics = worker_metrics.back().get();
+    worker_progress.push_back(std::make_unique<WorkerProgress>());
+    WorkerProgress* progress = worker_progress.back().get();
+
+    alive++;
+    workers.emplace_back([this, node, cpus = std::move(cpus), metrics, progress]() {
+        InitWorker(node, cpus, metrics, progress);
+    });
+    progress->has_cpu_clock = pthread_getcpuclockid(workers.back().native_handle(), &progress->cpu_clock) == 0;
+}
+
+// Folds the counters of a retiring worker into the pool totals and frees its slots, so an
+// elastic pool does not keep a WorkerMetrics for every worker it ever spawned.
+// Must be called under queue_mutex, the worker must not touch its metrics afterwards
+void TaskPool::RetireMetrics(const WorkerMetrics& metrics) {
+    auto slot = std::find_if(worker_metrics.begin(), worker_metrics.end(), [&metrics](const auto& slot) {
+        return slot.get() == &metrics;
+    });
+
+    AddMetrics(retired_metrics, metrics);
+    worker_progress.erase(worker_progress.begin() + (slot - worker_metrics.begin()));
+    worker_metrics.erase(slot);
+}
+
+// Workers that have been in the same task since the previous tick and spent it off the cpu,
+// sleeping or waiting for io. Must be called under queue_mutex
+size_t TaskPool::BlockedWorkers() {
+    using std::chrono::nanoseconds;
+
+    // the cpu time a sleeping thread may still pick up within a tick, e.g. for a page fault
+    const int64_t cpu_budget = std::chrono::duration_cast<nanoseconds>(options.grow_after).count() / 10;
+
+    size_t blocked = 0;
+    for (auto& progress : worker_progress) {
+        uint64_t steps = progress->steps.load(std::memory_order_relaxed);
+        if (steps % 2 == 0) {
+            progress->last_seen = steps;
+            continue;
+        }
+
+        int64_t cpu_ns = progress->has_cpu_clock ? ThreadCpuNs(progress->cpu_clock) : 0;
+        if (steps == progress->last_seen && progress->has_cpu_clock && cpu_ns - progress->last_cpu_ns <= cpu_budget &&
+            !ThreadRunnable(progress->tid.load(std::memory_order_relaxed))) {
+            blocked++;
+        }
+        progress->last_seen = steps;
+        progress->last_cpu_ns = cpu_ns;
+    }
+    return blocked;
+}
+
+// Replaces blocked workers while tasks wait and no worker is free, so a backlog of CPU-bound
+// tasks, short or preempted, never grows the pool past `workers`. Sleeps while nothing is queued
+void TaskPool::Supervise() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+
+    while (!stop) {
+        if (queued == 0) {
+            supervisor_parked = true;
+            cv_supervisor.wait(lock, [this]() {
+                return stop || queued > 0;
             });
+            supervisor_parked = false;
+            continue;
+        }
+
+        cv_supervisor.wait_for(lock, options.grow_after);
+        if (stop) {
+            return;
+        }
+
+        size_t blocked = BlockedWorkers();
+        bool has_idle = spinning > 0 || std::any_of(nodes.begin(), nodes.end(), [](const auto& node) {
+            return node->idle > node->wakeups;
+        });
+
+        if (queued > 0 && !has_idle && alive < options.workers + blocked && alive < options.max_workers) {
+            SpawnWorker();
+        }
+    }
+}
+
+// Queues the task and returns the node whose worker has to be woken for it, if any.
+// Must be called under queue_mutex
+TaskPool::NodeQueue* TaskPool::PushTask(std::shared_ptr<BaseTask>&& task, WorkerMetrics& metrics) {
+    size_t node = current_pool == this ? current_node : next_node++ % nodes.size();
+    nodes[node]->tasks.push(std::move(task));
+    queued++;
+
+    metrics.Add(metrics.enqueues);
+    queue_high_water = std::max(queue_high_water, queued.load(std::memory_order_relaxed));
+
+    if (supervisor_parked) {
+        supervisor_parked = false;
+        cv_supervisor.notify_one();
+    }
+
+    // a spinning worker will pick the task up without a wake up
+    if (spinning > spin_claims) {
+        spin_claims++;
+        return nullptr;
+    }
+
+    return FindIdleNode(node);
+}
+
+// Prefers a sleeping worker of the same node, then the closest node with one.
+// Must be called under queue_mutex
+TaskPool::NodeQueue* TaskPool::FindIdleNode(size_t node) {
+    auto has_idle = [](NodeQueue& queue) {
+        return queue.idle > queue.wakeups;
+    };
 
-            if(stop && tasks.empty()) {
-                return;
+    NodeQueue* target = nodes[node].get();
+    if (!has_idle(*target)) {
+        target = nullptr;
+        for (size_t victim : nodes[node]->victims) {
+            if (has_idle(*nodes[victim])) {
+                target = nodes[victim].get();
+                break;
             }
+        }
+    }
+
+    if (target) {
+        target->wakeups++;
+    }
+    return target;
+}
 
-            task = tasks.front();
-            tasks.pop();
-            tasks_in_progress++;
+// Takes a task from the local node first and steals from the closest nodes otherwise.
+// Must be called under queue_mutex
+std::shared_ptr<BaseTask> TaskPool::PopTask(size_t node, WorkerMetrics& metrics) {
+    NodeQueue* source = nodes[node].get();
+    if (source->tasks.empty()) {
+        for (size_t victim : source->victims) {
+            if (!nodes[victim]->tasks.empty()) {
+                source = nodes[victim].get();
+                metrics.Add(metrics.steals);
+                break;
+            }
         }
+    }
+
+    auto task = std::move(source->tasks.front());
+    source->tasks.pop();
+    queued--;
+    tasks_in_progress++;
+    return task;
+}
+
+// Spins with exponential backoff for `spin_for`, then parks.
+// Returns nullptr when the worker has to exit
+std::shared_ptr<BaseTask> TaskPool::WaitTask(size_t node, WorkerMetrics& metrics) {
+    if (options.spin_for.count() > 0) {
+        spinning++;
+        const auto deadline = std::chrono::steady_clock::now() + options.spin_for;
+        size_t backoff = 1;
 
+        while (true) {
+            if (queued.load(std::memory_order_relaxed) > 0) {
+                auto lock = TimedLock(queue_mutex, metrics.queue_mutex_wait_ns);
+                if (queued > 0) {
+                    spinning--;
+                    spin_claims = std::min(spin_claims > 0 ? spin_claims - 1 : 0, spinning.load());
+                    return PopTask(node, metrics);
+                }
+            }
+
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+
+            for (size_t i = 0; i < backoff; ++i) {
+                CpuRelax();
+            }
+
+            if (backoff < kMaxBackoff) {
+                backoff *= 2;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    auto lock = TimedLock(queue_mutex, metrics.queue_mutex_wait_ns);
+    if (options.spin_for.count() > 0) {
+        spinning--;
+        // the tasks claimed for this worker are still in the queue and checked below
+        spin_claims = std::min(spin_claims, spinning.load());
+    }
+
+    NodeQueue& local = *nodes[node];
+    auto ready = [this]() {
+        return stop || queued > 0;
+    };
+
+    local.idle++;
+    bool retire = false;
+    if (!ready()) {
+        metrics.Add(metrics.idle_parks);
+    }
+
+    while (!ready()) {
+        if (alive <= options.workers) {
+            local.cv_task.wait(lock, ready);
+        } else if (!local.cv_task.wait_for(lock, options.retire_after, ready) && alive > options.workers) {
+            retire = true;
+            break;
+        }
+    }
+    local.idle--;
+    if (local.wakeups > 0) {
+        local.wakeups--;
+    }
+
+    if (retire || (stop && queued == 0)) {
+        alive--;
+        retired.push_back(std::this_thread::get_id());
+        if (retire) {
+            RetireMetrics(metrics);
+        }
+        return nullptr;
+    }
+
+    return PopTask(node, metrics);
+}
+
+void TaskPool::InitWorker(size_t node, std::vector<int> cpus, WorkerMetrics* metrics, WorkerProgress* progress) {
+#ifdef __linux__
+    progress->tid.store(gettid(), std::memory_order_relaxed);
+#endif
+
+    if (!cpus.empty()) {
+        if (!PinCurrentThread(cpus)) {
+            pin_failures.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    current_pool = this;
+    current_node = node;
+    current_metrics = metrics;
+    size_t run_tick = 0;
+
+    while(true) {
+        std::shared_ptr<BaseTask> task = WaitTask(node, *metrics);
+        if (!task) {
+            return;
+        }
+
+        using std::chrono::nanoseconds;
+
+        bool ready_sampled = task->ready_at != std::chrono::steady_clock::time_point{};
+        bool sampled = ready_sampled || ++run_tick % options.metrics_sample_every == 0;
+
+        std::chrono::steady_clock::time_point start;
+        if (sampled) {
+            start = std::chrono::steady_clock::now();
+        }
+        if (ready_sampled) {
+            metrics->Record(metrics->ready_latency, std::chrono::duration_cast<nanoseconds>(start - task->ready_at).count());
+        }
+
+        progress->steps.store(progress->steps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
         task->Execute();
+        progress->steps.store(progress->steps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (sampled) {
+            const auto end = std::chrono::steady_clock::now();
+            metrics->Record(metrics->run_time, std::chrono::duration_cast<nanoseconds>(end - start).count());
+        }
+        metrics->Add(metrics->tasks_executed);
 
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
+            auto lock = TimedLock(queue_mutex, metrics->queue_mutex_wait_ns);
             tasks_in_progress--;
-            if (tasks.empty() && tasks_in_progress == 0) {
+            if (queued == 0 && tasks_in_progress == 0) {
                 cv_idle.notify_all();
             }
         }
@@ -8,40 +8,141 @@
 #include <mutex>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <span>
+
+#include <time.h>
+
+#include "metrics.h"
+#include "topology.h"
 
 class BaseTask {
+    friend class TaskPool;
+
+    // set when a sampled task is queued, used for the ready-to-start latency
+    std::chrono::steady_clock::time_point ready_at;
+
 public:
     virtual ~BaseTask() = default;
     virtual void Execute() = 0;
 };
 
+enum class AffinityPolicy {
+    None,   // workers are not pinned and share one queue
+    Cpu,    // every worker is pinned to a single cpu
+    Node,   // every worker is pinned to the cpus of its NUMA node
+};
+
+struct TaskPoolOptions {
+    // 0 means std::thread::hardware_concurrency()
+    size_t workers = 0;
+    // upper bound for the elastic growth, 0 means workers, which disables it
+    size_t max_workers = 0;
+    AffinityPolicy affinity = AffinityPolicy::None;
+
+    // how long an idle worker polls the queue with backoff before parking on the condition variable
+    std::chrono::microseconds spin_for{50};
+    // a worker that has been sleeping in the same task for this long counts as blocked, and a new
+    // worker is spawned in its place while tasks are waiting and no worker is free
+    std::chrono::milliseconds grow_after{5};
+    // workers spawned above `workers` exit after being parked for this long
+    std::chrono::milliseconds retire_after{1000};
+
+    // every n-th task is timed for the run time and ready latency histograms, 1 times all of them.
+    // Reading the clock costs tens of nanoseconds, which is a lot next to a tiny task
+    size_t metrics_sample_every = 64;
+};
+
 class TaskPool final {
 public:
-    TaskPool(size_t workers_size) : tasks_in_progress(0) {
-        for(int i = 0; i < workers_size; i++) {
-            workers.emplace_back([this]() { InitWorker(); });
-        }
-    }
+    TaskPool(size_t workers_size)
+        : TaskPool(TaskPoolOptions{.workers = workers_size, .max_workers = workers_size}) {}
+    TaskPool(const TaskPoolOptions& options);
 
     ~TaskPool() {
         Stop();
     }
 
+    // Tasks enqueued from a worker go to the queue of its NUMA node
     void EnqueueTask(std::shared_ptr<BaseTask>&& task);
+    // Pushes all tasks under a single lock and wakes at most one worker per task
+    void EnqueueBatch(std::span<std::shared_ptr<BaseTask>> batch);
     void WaitIdle();
     void Stop();
 
+    size_t NodesCount() const {
+        return nodes.size();
+    }
+
+    size_t WorkersCount();
+
+    TaskPoolStats Stats();
+
 private:
-    void InitWorker();
+    struct NodeQueue {
+        std::queue<std::shared_ptr<BaseTask>> tasks;
+        std::condition_variable cv_task;
+        std::vector<size_t> victims;
+        size_t idle = 0;
+        size_t wakeups = 0;
+    };
+
+    // Bumped by its worker before and after every task, so the value is odd while a task runs.
+    // The supervisor compares it and the thread cpu time between two ticks to find workers
+    // sleeping in one task
+    struct alignas(64) WorkerProgress {
+        std::atomic<uint64_t> steps = 0;
+        // kernel thread id, set by the worker when it starts
+        std::atomic<int> tid = 0;
+        clockid_t cpu_clock{};
+        bool has_cpu_clock = false;
+        uint64_t last_seen = 0;
+        int64_t last_cpu_ns = 0;
+    };
+
+    void InitWorker(size_t node, std::vector<int> cpus, WorkerMetrics* metrics, WorkerProgress* progress);
+    size_t BlockedWorkers();
+    void RetireMetrics(const WorkerMetrics& metrics);
+    void SpawnWorker();
+    void Supervise();
+
+    std::shared_ptr<BaseTask> WaitTask(size_t node, WorkerMetrics& metrics);
+    std::shared_ptr<BaseTask> PopTask(size_t node, WorkerMetrics& metrics);
+    NodeQueue* PushTask(std::shared_ptr<BaseTask>&& task, WorkerMetrics& metrics);
+    WorkerMetrics& CurrentMetrics();
+    NodeQueue* FindIdleNode(size_t node);
+
+    TaskPoolOptions options;
+    CpuTopology topology;
+    std::vector<std::unique_ptr<NodeQueue>> nodes;
 
     std::vector<std::thread> workers;
+    std::vector<std::thread::id> retired;
+    // one slot per live worker, the progress of a worker has the index of its metrics
+    std::vector<std::unique_ptr<WorkerMetrics>> worker_metrics;
+    std::vector<std::unique_ptr<WorkerProgress>> worker_progress;
+    // counters of the retired workers, so totals never go back
+    TaskPoolStats retired_metrics;
+    // shared by the threads that are not workers of this pool
+    WorkerMetrics external_metrics{false};
+    std::thread supervisor;
 
-    std::queue<std::shared_ptr<BaseTask>> tasks;
     std::mutex queue_mutex;
 
-    std::condition_variable cv_task;
     std::condition_variable cv_idle;
+    std::condition_variable cv_supervisor;
 
     bool stop = false;
+    // the supervisor sleeps until a task is queued, PushTask wakes it
+    bool supervisor_parked = false;
+    std::atomic<size_t> queued = 0;
+    std::atomic<size_t> spinning = 0;
+    // workers that asked for an affinity and run unpinned because the kernel refused it
+    std::atomic<size_t> pin_failures = 0;
+    size_t spin_claims = 0;
+    size_t next_node = 0;
+    size_t spawned = 0;
+    size_t alive = 0;
     size_t tasks_in_progress = 0;
+    size_t queue_high_water = 0;
 };
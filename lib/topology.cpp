@@ -0,0 +1,159 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+const std::string kNodesPath = "/sys/devices/system/node/";
+
+bool ReadLine(const std::string& path, std::string& line) {
+    std::ifstream file(path);
+    return file && std::getline(file, line);
+}
+
+}
+
+std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+std::vector<int> AllowedCpus() {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+
+        if (!cpus.empty()) {
+            return cpus;
+        }
+    }
+#endif
+
+    std::vector<int> cpus(std::max(1u, std::thread::hardware_concurrency()));
+    std::iota(cpus.begin(), cpus.end(), 0);
+    return cpus;
+}
+
+CpuTopology CpuTopology::Flat() {
+    CpuTopology topology;
+    topology.node_cpus.push_back(AllowedCpus());
+    topology.distance = {{10}};
+    return topology;
+}
+
+CpuTopology CpuTopology::Detect() {
+    std::string online;
+    if (!ReadLine(kNodesPath + "online", online)) {
+        return Flat();
+    }
+
+    // a cpuset may hide some cpus (or whole nodes) from the process, workers must not be pinned there
+    std::vector<int> allowed = AllowedCpus();
+
+    CpuTopology topology;
+    std::vector<size_t> online_positions;
+    std::vector<std::vector<int>> rows;
+    std::vector<int> online_nodes = ParseCpuList(online);
+    for (size_t position = 0; position < online_nodes.size(); ++position) {
+        int node = online_nodes[position];
+        std::string node_path = kNodesPath + "node" + std::to_string(node) + "/";
+        std::string cpulist;
+        std::string distances;
+        if (!ReadLine(node_path + "cpulist", cpulist) || !ReadLine(node_path + "distance", distances)) {
+            return Flat();
+        }
+
+        std::vector<int> cpus = ParseCpuList(cpulist);
+        std::erase_if(cpus, [&allowed](int cpu) {
+            return !std::binary_search(allowed.begin(), allowed.end(), cpu);
+        });
+        if (cpus.empty()) {
+            // memory-only node or none of its cpus are allowed, nothing to run on it
+            continue;
+        }
+
+        std::vector<int> row;
+        std::stringstream stream(distances);
+        for (int value; stream >> value;) {
+            row.push_back(value);
+        }
+
+        topology.node_cpus.push_back(std::move(cpus));
+        online_positions.push_back(position);
+        rows.push_back(std::move(row));
+    }
+
+    if (topology.node_cpus.empty()) {
+        return Flat();
+    }
+
+    // distance rows list every online node, keep only the columns of nodes with cpus
+    for (const auto& row : rows) {
+        std::vector<int> filtered;
+        for (size_t position : online_positions) {
+            filtered.push_back(position < row.size() ? row[position] : 10);
+        }
+        topology.distance.push_back(std::move(filtered));
+    }
+
+    return topology;
+}
+
+std::vector<size_t> CpuTopology::Neighbours(size_t node) const {
+    std::vector<size_t> result;
+    for (size_t other = 0; other < NodesCount(); ++other) {
+        if (other != node) {
+            result.push_back(other);
+        }
+    }
+
+    std::stable_sort(result.begin(), result.end(), [&](size_t left, size_t right) {
+        return distance[node][left] < distance[node][right];
+    });
+    return result;
+}
+
+bool PinCurrentThread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// CPUs grouped by NUMA node, read from /sys/devices/system/node and restricted to the CPUs
+// the process may run on. Falls back to a single node with every allowed CPU when sysfs is not available.
+struct CpuTopology {
+    std::vector<std::vector<int>> node_cpus;
+    std::vector<std::vector<int>> distance;
+
+    static CpuTopology Detect();
+    static CpuTopology Flat();
+
+    size_t NodesCount() const {
+        return node_cpus.size();
+    }
+
+    // Other nodes ordered from the closest to the farthest one
+    std::vector<size_t> Neighbours(size_t node) const;
+};
+
+// Parses kernel cpu lists like "0-3,8,10-11"
+std::vector<int> ParseCpuList(const std::string& list);
+
+// CPUs in the affinity mask of the process, 0..hardware_concurrency-1 where it can not be read
+std::vector<int> AllowedCpus();
+
+// Restricts the calling thread to the given CPUs, returns false if it is not supported
+bool PinCurrentThread(const std::vector<int>& cpus);
@@ -0,0 +1,30 @@
+#include "typed_graph.h"
+
+void typed_graph::NodeBase::Execute() {
+    Run();
+
+    for (auto& child : children) {
+        if (child->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            // aliasing an empty shared_ptr gives a pointer without a control block
+            ready.push_back(std::shared_ptr<BaseTask>(std::shared_ptr<BaseTask>(), child));
+        }
+    }
+
+    if (!ready.empty()) {
+        pool->EnqueueBatch(ready);
+        ready.clear();
+    }
+}
+
+void TTypedTaskGraph::executeAll() {
+    std::vector<std::shared_ptr<BaseTask>> roots;
+    for (auto& node : nodes) {
+        node->pending.store(node->dependencies, std::memory_order_relaxed);
+        if (node->dependencies == 0) {
+            roots.push_back(node);
+        }
+    }
+
+    pool.EnqueueBatch(roots);
+    pool.WaitIdle();
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "task_pool.h"
+
+class TTypedTaskGraph;
+
+template<typename T>
+class TaskHandle;
+
+namespace typed_graph {
+
+template<typename T>
+const T& resolve(const TaskHandle<T>& handle);
+
+class NodeBase : public BaseTask {
+    friend TTypedTaskGraph;
+
+    // non-owning: the graph owns every node and children own their parents through the
+    // handles in their inputs, so owning edges here would make a cycle
+    std::vector<NodeBase*> children;
+    // released children as non-owning pointers, sized once when the graph is built
+    // so execution does not allocate
+    std::vector<std::shared_ptr<BaseTask>> ready;
+    size_t dependencies = 0;
+    std::atomic<size_t> pending = 0;
+
+protected:
+    const TTypedTaskGraph* graph;
+    TaskPool* pool;
+
+    virtual void Run() = 0;
+
+public:
+    NodeBase(const TTypedTaskGraph* owner, TaskPool* task_pool) : graph(owner), pool(task_pool) {}
+
+    void Execute() final;
+};
+
+template<typename T>
+class ResultNode : public NodeBase {
+public:
+    using NodeBase::NodeBase;
+
+    std::optional<T> value;
+};
+
+}
+
+// Handle of a node whose result type is known at compile time
+template<typename T>
+class TaskHandle {
+    friend TTypedTaskGraph;
+    friend const T& typed_graph::resolve<T>(const TaskHandle<T>& handle);
+
+    std::shared_ptr<typed_graph::ResultNode<T>> node;
+
+    explicit TaskHandle(std::shared_ptr<typed_graph::ResultNode<T>> n) : node(std::move(n)) {}
+
+public:
+    using value_type = T;
+};
+
+namespace typed_graph {
+
+template<typename T>
+struct input_traits {
+    using value_type = T;
+    static constexpr bool is_handle = false;
+};
+
+template<typename T>
+struct input_traits<TaskHandle<T>> {
+    using value_type = T;
+    static constexpr bool is_handle = true;
+};
+
+template<typename T>
+using input_value_t = typename input_traits<std::decay_t<T>>::value_type;
+
+template<typename T>
+const T& resolve(const T& constant) {
+    return constant;
+}
+
+template<typename Functor, typename... Inputs>
+using result_t = std::decay_t<std::invoke_result_t<Functor&, const input_value_t<Inputs>&...>>;
+
+template<typename Functor, typename... Inputs>
+class FunctionNode : public ResultNode<result_t<Functor, Inputs...>> {
+    Functor func_;
+    std::tuple<std::decay_t<Inputs>...> inputs_;
+
+public:
+    template<typename F, typename... Args>
+    FunctionNode(const TTypedTaskGraph* owner, TaskPool* pool, F&& func, Args&&... inputs)
+        : ResultNode<result_t<Functor, Inputs...>>(owner, pool)
+        , func_(std::forward<F>(func))
+        , inputs_(std::forward<Args>(inputs)...) {}
+
+    void Run() override {
+        this->value.emplace(std::apply([this](const auto&... inputs) {
+            return func_(resolve(inputs)...);
+        }, inputs_));
+    }
+};
+
+}
+
+// Task graph with statically typed edges: results live in typed slots and
+// wiring errors are rejected at compile time, no AnyType and no RTTI on the hot path.
+class TTypedTaskGraph {
+    std::vector<std::shared_ptr<typed_graph::NodeBase>> nodes;
+    TaskPool pool;
+
+    template<typename Input>
+    void collectParent(std::vector<typed_graph::NodeBase*>& parents, const Input& input) const {
+        if constexpr (typed_graph::input_traits<std::decay_t<Input>>::is_handle) {
+            if (!input.node || input.node->graph != this) {
+                throw std::runtime_error("task handle belongs to another graph");
+            }
+
+            parents.push_back(input.node.get());
+        }
+    }
+
+public:
+    TTypedTaskGraph() : pool(TaskPoolOptions{}) {}
+    TTypedTaskGraph(size_t workers_count) : pool(workers_count) {}
+    TTypedTaskGraph(const TaskPoolOptions& options) : pool(options) {}
+
+    template<typename Functor, typename... Inputs>
+    auto add(Functor&& func, Inputs&&... inputs) {
+        using functor_type = std::decay_t<Functor>;
+        static_assert(sizeof...(Inputs) > 0, "task needs at least one input");
+        static_assert(std::is_invocable_v<functor_type&, const typed_graph::input_value_t<Inputs>&...>,
+            "task inputs do not match the functor arguments");
+
+        using node_type = typed_graph::FunctionNode<functor_type, Inputs...>;
+        using result_type = typed_graph::result_t<functor_type, Inputs...>;
+        static_assert(!std::is_void_v<result_type>, "task has to return a value");
+
+        std::vector<typed_graph::NodeBase*> parents;
+        (collectParent(parents, inputs), ...);
+
+        auto node = std::make_shared<node_type>(
+            this, &pool, std::forward<Functor>(func), std::forward<Inputs>(inputs)...);
+        nodes.push_back(node);
+
+        for (auto* parent : parents) {
+            parent->children.push_back(node.get());
+            parent->ready.reserve(parent->children.size());
+            node->dependencies++;
+        }
+
+        return TaskHandle<result_type>(std::move(node));
+    }
+
+    void executeAll();
+
+    template<typename T>
+    const T& getResult(const TaskHandle<T>& handle) const {
+        if (!handle.node || handle.node->graph != this) {
+            throw std::runtime_error("task handle belongs to another graph");
+        }
+
+        if (!handle.node->value) {
+            throw std::runtime_error("task was not executed");
+        }
+
+        return *handle.node->value;
+    }
+};
+
+template<typename T>
+const T& typed_graph::resolve(const TaskHandle<T>& handle) {
+    return *handle.node->value;
+}
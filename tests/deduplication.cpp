@@ -0,0 +1,69 @@
+#include "lib/scheduler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+static std::atomic<int> sqrt_calls = 0;
+
+TEST(Deduplication, same_constant_inputs) {
+    TTaskScheduler scheduler;
+    scheduler.enableDeduplication();
+
+    auto square = [](int x) { return x * x; };
+
+    auto id1 = scheduler.add(square, 10);
+    auto id2 = scheduler.add(square, 10);
+    auto id3 = scheduler.add(square, 11);
+
+    ASSERT_EQ(id1, id2);
+    ASSERT_NE(id1, id3);
+    ASSERT_THAT(scheduler.getResult<int>(id2), 100);
+}
+
+TEST(Deduplication, same_promised_inputs) {
+    TTaskScheduler scheduler;
+    scheduler.enableDeduplication();
+
+    float a = 1;
+    float b = -2;
+    float c = 0;
+
+    auto discriminant = [](float b, float v) { return b * b + v; };
+    auto root = [](float b, float d) {
+        sqrt_calls++;
+        return -b + std::sqrt(d);
+    };
+
+    auto id1 = scheduler.add([](float a, float c) { return -4 * a * c; }, a, c);
+    auto id2 = scheduler.add(discriminant, b, scheduler.getFutureResult<float>(id1));
+    auto id3 = scheduler.add(root, b, scheduler.getFutureResult<float>(id2));
+    auto id4 = scheduler.add(root, b, scheduler.getFutureResult<float>(id2));
+
+    ASSERT_EQ(id3, id4);
+
+    sqrt_calls = 0;
+    scheduler.executeAll();
+
+    ASSERT_THAT(scheduler.getResult<float>(id4), 4);
+    ASSERT_THAT(sqrt_calls.load(), 1);
+}
+
+TEST(Deduplication, disabled_by_default) {
+    TTaskScheduler scheduler;
+
+    auto square = [](int x) { return x * x; };
+
+    ASSERT_NE(scheduler.add(square, 10), scheduler.add(square, 10));
+}
+
+TEST(Deduplication, stateful_functor_is_not_shared) {
+    TTaskScheduler scheduler;
+    scheduler.enableDeduplication();
+
+    int offset = 1;
+    auto add_offset = [offset](int x) { return x + offset; };
+
+    ASSERT_NE(scheduler.add(add_offset, 10), scheduler.add(add_offset, 10));
+}
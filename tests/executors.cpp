@@ -0,0 +1,163 @@
+#include "lib/graph_file.h"
+#include "lib/scheduler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace {
+
+// Waits for the flag for up to a second, returns whether it was set
+bool WaitFor(const std::atomic<bool>& flag) {
+    for (int i = 0; i < 1000 && !flag; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return flag;
+}
+
+}
+
+TEST(Executors, blocking_task_does_not_take_compute_worker) {
+    TTaskScheduler scheduler(1);
+    std::atomic<bool> computed = false;
+
+    // on a shared single worker pool whichever of the two runs first would block the other
+    auto io = scheduler.on(ExecutorClass::BlockingIo).add([&computed](int) { return WaitFor(computed); }, 0);
+    auto compute = scheduler.add([&computed](int x) {
+        computed = true;
+        return x * 2;
+    }, 21);
+
+    scheduler.executeAll();
+
+    ASSERT_TRUE(scheduler.getResult<bool>(io));
+    ASSERT_EQ(scheduler.getResult<int>(compute), 42);
+}
+
+TEST(Executors, edges_across_executors) {
+    TTaskScheduler scheduler(2);
+    std::mutex mutex;
+    std::set<std::thread::id> compute_threads;
+    std::set<std::thread::id> io_threads;
+
+    auto remember = [&mutex](std::set<std::thread::id>& threads) {
+        std::lock_guard lock(mutex);
+        threads.insert(std::this_thread::get_id());
+    };
+
+    auto io = scheduler.on(ExecutorClass::BlockingIo);
+    auto id1 = io.add([&](int x) {
+        remember(io_threads);
+        return x + 1;
+    }, 1);
+    auto id2 = scheduler.add([&](int x) {
+        remember(compute_threads);
+        return x * 10;
+    }, scheduler.getFutureResult<int>(id1));
+    auto id3 = io.add([&](int x, int y) {
+        remember(io_threads);
+        return x + y;
+    }, scheduler.getFutureResult<int>(id2), scheduler.getFutureResult<int>(id1));
+
+    ASSERT_EQ(scheduler.getResult<int>(id3), 22);
+    ASSERT_FALSE(io_threads.empty());
+    ASSERT_FALSE(compute_threads.empty());
+    for (auto thread : io_threads) {
+        ASSERT_FALSE(compute_threads.contains(thread));
+    }
+}
+
+TEST(Executors, named_executor) {
+    TTaskScheduler scheduler(1);
+    scheduler.registerExecutor("disk", TaskPoolOptions{.workers = 2, .max_workers = 2});
+
+    auto id1 = scheduler.on("disk").add([](int x) { return x * 3; }, 5);
+    auto id2 = scheduler.add([](int x) { return x + 1; }, scheduler.getFutureResult<int>(id1));
+
+    scheduler.executeAll();
+
+    auto stats = scheduler.stats();
+    ASSERT_TRUE(stats.executors.contains("disk"));
+    ASSERT_EQ(stats.executors["disk"].tasks_executed, 1);
+    ASSERT_EQ(stats.pool.tasks_executed, 1);
+    std::string prometheus = FormatPrometheus(stats);
+    ASSERT_THAT(prometheus, ::testing::HasSubstr("task_scheduler_tasks_executed_total{executor=\"disk\"} 1"));
+    ASSERT_THAT(prometheus, ::testing::HasSubstr("task_scheduler_tasks_executed_total{executor=\"compute\"} 1"));
+    ASSERT_THAT(FormatStats(stats), ::testing::HasSubstr("executor disk:"));
+    ASSERT_EQ(scheduler.getResult<int>(id2), 16);
+}
+
+TEST(Executors, unknown_and_duplicate_names) {
+    TTaskScheduler scheduler(1);
+    scheduler.registerExecutor("disk", TaskPoolOptions{.workers = 1, .max_workers = 1});
+
+    ASSERT_THROW(scheduler.on("network"), std::runtime_error);
+    ASSERT_THROW(scheduler.registerExecutor("disk", TaskPoolOptions{}), std::runtime_error);
+    ASSERT_THROW(scheduler.registerExecutor("compute", TaskPoolOptions{}), std::runtime_error);
+}
+
+TEST(Executors, levels_engine) {
+    TTaskScheduler scheduler(2);
+
+    auto io = scheduler.on(ExecutorClass::BlockingIo);
+    int a = io.add([](int x) { return x + 1; }, 1);
+    int b = scheduler.add([](int x) { return x + 2; }, 2);
+    int c = io.add([](int x, int y) { return x * y; },
+        scheduler.getFutureResult<int>(a), scheduler.getFutureResult<int>(b));
+    int d = scheduler.add([](int x) { return x - 1; }, scheduler.getFutureResult<int>(c));
+
+    scheduler.executeAll(ExecutionEngine::Levels);
+
+    ASSERT_EQ(scheduler.stats().executors["blocking-io"].tasks_executed, 2);
+    ASSERT_EQ(scheduler.getResult<int>(d), 7);
+}
+
+TEST(Executors, deduplication_keeps_executors_apart) {
+    TTaskScheduler scheduler(1);
+    scheduler.enableDeduplication();
+
+    auto square = [](int x) { return x * x; };
+    int id1 = scheduler.add(square, 3);
+    int id2 = scheduler.on(ExecutorClass::BlockingIo).add(square, 3);
+    int id3 = scheduler.on(ExecutorClass::BlockingIo).add(square, 3);
+
+    ASSERT_NE(id1, id2);
+    ASSERT_EQ(id2, id3);
+    ASSERT_EQ(scheduler.getResult<int>(id2), 9);
+}
+
+static int increment(int x) {
+    return x + 1;
+}
+
+TEST(Executors, saved_graph_keeps_executors) {
+    auto path = std::filesystem::temp_directory_path() / "executors_graph.tsg";
+
+    TaskRegistry registry;
+    registry.addOne<int>("increment", &increment);
+
+    {
+        TTaskScheduler scheduler(1);
+        scheduler.registerExecutor("disk", TaskPoolOptions{.workers = 1, .max_workers = 1});
+        int id = scheduler.on("disk").add(&increment, 1);
+        scheduler.add(&increment, scheduler.getFutureResult<int>(id));
+        scheduler.save(path, registry);
+    }
+
+    TTaskScheduler missing(1);
+    ASSERT_THROW(missing.load(path, registry), std::runtime_error);
+
+    TTaskScheduler scheduler(1);
+    scheduler.registerExecutor("disk", TaskPoolOptions{.workers = 1, .max_workers = 1});
+    scheduler.load(path, registry);
+
+    ASSERT_EQ(scheduler.getResult<int>(1), 3);
+    ASSERT_EQ(scheduler.stats().executors["disk"].tasks_executed, 1);
+
+    std::filesystem::remove(path);
+}
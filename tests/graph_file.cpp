@@ -0,0 +1,154 @@
+#include "lib/graph_file.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+struct Dump {
+    int divide(int x) {
+        return x / 2;
+    }
+};
+
+auto increment = [](int x) { return x + 10; };
+auto sum = [](int x, int y) { return x + y; };
+auto length = [](const std::string& s) { return static_cast<int>(s.size()); };
+auto total = [](const std::vector<int>& vctr) {
+    int result = 0;
+    for (int elem : vctr) {
+        result += elem;
+    }
+    return result;
+};
+
+TaskRegistry MakeRegistry() {
+    TaskRegistry registry;
+    registry.addOne<int>("increment", increment);
+    registry.addTwo<int, int>("sum", sum);
+    registry.addOne<std::string>("length", length);
+    registry.addOne<std::vector<int>>("total", total);
+    registry.addMethod("divide", &Dump::divide, Dump{});
+    return registry;
+}
+
+std::string TempPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+}
+
+TEST(GraphFile, round_trip) {
+    TaskRegistry registry = MakeRegistry();
+    std::string path = TempPath("round_trip.tsg");
+
+    {
+        TTaskScheduler scheduler;
+
+        auto id1 = scheduler.add(increment, 10);
+        auto id2 = scheduler.add(length, std::string("hello"));
+        auto id3 = scheduler.add(total, std::vector<int>{1, 2, 3});
+        scheduler.add(sum, scheduler.getFutureResult<int>(id1), scheduler.getFutureResult<int>(id2));
+        auto id5 = scheduler.add(sum, 4, scheduler.getFutureResult<int>(id3));
+        scheduler.add(&Dump::divide, Dump{}, scheduler.getFutureResult<int>(id5));
+
+        scheduler.executeAll();
+        scheduler.save(path, registry);
+    }
+
+    TTaskScheduler scheduler;
+    scheduler.load(path, registry);
+
+    ASSERT_THAT(scheduler.getResult<int>(3), 25);
+    ASSERT_THAT(scheduler.getResult<int>(5), 5);
+
+    std::filesystem::remove(path);
+}
+
+TEST(GraphFile, unregistered_functor_error) {
+    TaskRegistry registry = MakeRegistry();
+    TTaskScheduler scheduler;
+
+    scheduler.add([](int x) { return x; }, 10);
+
+    ASSERT_ANY_THROW(scheduler.save(TempPath("unregistered.tsg"), registry));
+}
+
+TEST(GraphFile, not_serializable_input_error) {
+    TaskRegistry registry;
+    auto to_string = [](std::string s) { return s; };
+    registry.addOne<const char*>("to_string", to_string);
+
+    TTaskScheduler scheduler;
+    scheduler.add(to_string, "10");
+
+    ASSERT_ANY_THROW(scheduler.save(TempPath("not_serializable.tsg"), registry));
+}
+
+TEST(GraphFile, unknown_kind_error) {
+    std::string path = TempPath("unknown_kind.tsg");
+    {
+        TaskRegistry registry = MakeRegistry();
+        TTaskScheduler scheduler;
+        scheduler.add(increment, 10);
+        scheduler.save(path, registry);
+    }
+
+    TTaskScheduler scheduler;
+    ASSERT_ANY_THROW(scheduler.load(path, TaskRegistry{}));
+    ASSERT_ANY_THROW(scheduler.load(TempPath("missing.tsg"), TaskRegistry{}));
+
+    std::filesystem::remove(path);
+}
+
+TEST(GraphFile, huge_counts_error) {
+    std::string path = TempPath("huge_counts.tsg");
+    {
+        GraphWriter writer;
+        writer.write<uint32_t>(0x31475354);
+        writer.write<uint32_t>(2);
+        writer.write<uint32_t>(0xFFFFFFF0);
+        writer.write<uint32_t>(0);
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(writer.data().data(), writer.size());
+    }
+
+    TTaskScheduler scheduler;
+    ASSERT_THROW(scheduler.load(path, MakeRegistry()), std::runtime_error);
+
+    GraphWriter writer;
+    writer.write<uint32_t>(0xFFFFFFFF);
+    GraphReader reader(writer.data());
+    ASSERT_THROW(reader.read<std::vector<int>>(), std::runtime_error);
+
+    std::filesystem::remove(path);
+}
+
+TEST(GraphFile, in_degree_mismatch_error) {
+    std::string path = TempPath("in_degree.tsg");
+    TaskRegistry registry = MakeRegistry();
+    {
+        TTaskScheduler scheduler;
+        int id = scheduler.add(increment, 1);
+        scheduler.add(increment, scheduler.getFutureResult<int>(id));
+        scheduler.save(path, registry);
+    }
+
+    // the last node has no children, so its in_degree is followed only by the children count
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(-8, std::ios::end);
+        uint32_t degree = 2;
+        file.write(reinterpret_cast<const char*>(&degree), sizeof(degree));
+    }
+
+    TTaskScheduler scheduler;
+    ASSERT_THROW(scheduler.load(path, registry), std::runtime_error);
+    ASSERT_FALSE(scheduler.isFinalized());
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,56 @@
+#include "lib/scheduler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+TEST(Levels, level_engine) {
+    TTaskScheduler scheduler(TaskPoolOptions{.workers = 3});
+
+    std::vector<int> layer;
+    for (int i = 0; i < 100; ++i) {
+        layer.push_back(scheduler.add([](int x) { return x; }, i));
+    }
+
+    for (int depth = 0; depth < 5; ++depth) {
+        std::vector<int> next;
+        for (int id : layer) {
+            next.push_back(scheduler.add([](int x) { return x + 1; }, scheduler.getFutureResult<int>(id)));
+        }
+        layer = std::move(next);
+    }
+
+    scheduler.executeAll(ExecutionEngine::Levels);
+
+    ASSERT_TRUE(scheduler.isFinalized());
+    ASSERT_THAT(scheduler.levels().size(), 6);
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_THAT(scheduler.getResult<int>(layer[i]), i + 5);
+    }
+}
+
+TEST(Levels, dynamic_after_levels_does_not_rerun) {
+    TTaskScheduler scheduler(2);
+    std::atomic<int> runs = 0;
+
+    auto increment = [&runs](int x) {
+        runs++;
+        return x + 1;
+    };
+    int a = scheduler.add(increment, 1);
+    int b = scheduler.add(increment, scheduler.getFutureResult<int>(a));
+    int c = scheduler.add([&runs](int x, int y) {
+        runs++;
+        return x * y;
+    }, scheduler.getFutureResult<int>(a), scheduler.getFutureResult<int>(b));
+
+    scheduler.executeAll(ExecutionEngine::Levels);
+    ASSERT_THAT(runs.load(), 3);
+
+    ASSERT_THAT(scheduler.getResult<int>(c), 6);
+    scheduler.executeAll();
+    ASSERT_THAT(scheduler.getResult<int>(b), 3);
+    ASSERT_THAT(runs.load(), 3);
+}
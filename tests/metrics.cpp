@@ -0,0 +1,58 @@
+#include "lib/scheduler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+TEST(Metrics, histogram_buckets) {
+    for (uint64_t ns : {0ull, 1ull, 7ull, 8ull, 100ull, 12345ull, 1ull << 40, ~0ull}) {
+        size_t index = LatencyHistogram::BucketIndex(ns);
+
+        ASSERT_LT(index, LatencyHistogram::kBuckets);
+        ASSERT_GE(LatencyHistogram::BucketUpperBound(index), ns);
+        if (index > 0) {
+            ASSERT_LT(LatencyHistogram::BucketUpperBound(index - 1), ns);
+        }
+    }
+}
+
+TEST(Metrics, histogram_percentile) {
+    LatencyHistogram histogram;
+    for (uint64_t ns = 1; ns <= 1000; ++ns) {
+        histogram.Record(ns, true);
+    }
+
+    HistogramSnapshot snapshot = histogram.Snapshot();
+
+    ASSERT_THAT(snapshot.count, 1000);
+    ASSERT_THAT(snapshot.sum_ns, 500500);
+    ASSERT_NEAR(snapshot.Percentile(0.5), 500, 500 / 8);
+    ASSERT_NEAR(snapshot.Percentile(0.99), 990, 990 / 8);
+    ASSERT_GE(snapshot.Percentile(1.0), 1000);
+}
+
+TEST(Metrics, scheduler_stats) {
+    TTaskScheduler scheduler(TaskPoolOptions{.workers = 2, .metrics_sample_every = 1});
+
+    int id = scheduler.add([](int x) { return x; }, 0);
+    for (int i = 0; i < 99; ++i) {
+        id = scheduler.add([](int x) { return x + 1; }, scheduler.getFutureResult<int>(id));
+    }
+    scheduler.executeAll();
+
+    SchedulerStats stats = scheduler.stats();
+
+    ASSERT_THAT(stats.pool.workers, 2);
+    ASSERT_THAT(stats.pool.tasks_executed, 100);
+    ASSERT_THAT(stats.pool.enqueues, 100);
+    ASSERT_GE(stats.pool.queue_high_water, 1);
+    ASSERT_THAT(stats.pool.run_time.count, 100);
+    ASSERT_THAT(stats.pool.ready_latency.count, 100);
+
+    std::string text = FormatStats(stats);
+    ASSERT_THAT(text, testing::HasSubstr("tasks executed: 100"));
+
+    std::string prometheus = FormatPrometheus(stats);
+    ASSERT_THAT(prometheus, testing::HasSubstr("task_scheduler_tasks_executed_total{executor=\"compute\"} 100"));
+    ASSERT_THAT(prometheus, testing::HasSubstr("task_scheduler_task_run_seconds_count{executor=\"compute\"} 100"));
+    ASSERT_THAT(prometheus, testing::HasSubstr("# TYPE task_scheduler_task_ready_latency_seconds histogram"));
+}
@@ -0,0 +1,106 @@
+#include "lib/scheduler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct NoDefault {
+    explicit NoDefault(int v) : value(v) {}
+
+    int value;
+};
+
+struct Counted {
+    static inline int copies = 0;
+    static inline int moves = 0;
+
+    explicit Counted(std::vector<int> v) : data(std::move(v)) {}
+    Counted(const Counted& other) : data(other.data) {
+        copies++;
+    }
+    Counted(Counted&& other) noexcept : data(std::move(other.data)) {
+        moves++;
+    }
+
+    std::vector<int> data;
+};
+
+struct Measure {
+    size_t size(const Counted& c) {
+        return c.data.size();
+    }
+};
+
+struct Scale {
+    int factor;
+
+    int apply(const std::unique_ptr<int>& value) {
+        return *value * factor;
+    }
+};
+
+}
+
+TEST(MoveOnly, unique_ptr_constant) {
+    TTaskScheduler scheduler;
+
+    auto id = scheduler.add([](const std::unique_ptr<int>& p) { return *p + 1; }, std::make_unique<int>(41));
+
+    ASSERT_EQ(scheduler.getResult<int>(id), 42);
+}
+
+TEST(MoveOnly, unique_ptr_chain) {
+    TTaskScheduler scheduler;
+
+    auto id1 = scheduler.add([](int x) { return std::make_unique<int>(x); }, 5);
+    auto id2 = scheduler.add([](const std::unique_ptr<int>& p) { return std::make_unique<int>(*p * 2); },
+        scheduler.getFutureResult<std::unique_ptr<int>>(id1));
+    auto id3 = scheduler.add(&Scale::apply, Scale{3}, scheduler.getFutureResult<std::unique_ptr<int>>(id2));
+
+    const auto& doubled = scheduler.getResult<std::unique_ptr<int>>(id2);
+    ASSERT_EQ(*doubled, 10);
+    ASSERT_EQ(scheduler.getResult<int>(id3), 30);
+}
+
+TEST(MoveOnly, not_default_constructible) {
+    TTaskScheduler scheduler;
+
+    auto id1 = scheduler.add([](const NoDefault& v) { return NoDefault(v.value + 1); }, NoDefault(1));
+    auto id2 = scheduler.add([](const NoDefault& l, const NoDefault& r) { return NoDefault(l.value * r.value); },
+        NoDefault(10), scheduler.getFutureResult<NoDefault>(id1));
+
+    ASSERT_EQ(scheduler.getResult<NoDefault>(id2).value, 20);
+}
+
+TEST(MoveOnly, no_copies_of_large_values) {
+    TTaskScheduler scheduler;
+    Counted::copies = 0;
+    Counted::moves = 0;
+
+    auto id1 = scheduler.add([](const Counted& c) {
+        std::vector<int> data(c.data);
+        data.push_back(4);
+        return Counted(std::move(data));
+    }, Counted({1, 2, 3}));
+    auto id2 = scheduler.add([](const Counted& l, const Counted& r) {
+        return Counted({static_cast<int>(l.data.size() + r.data.size())});
+    }, scheduler.getFutureResult<Counted>(id1), scheduler.getFutureResult<Counted>(id1));
+    auto id3 = scheduler.add([](const Counted& l, const Counted& r) {
+        return l.data.size() + r.data.size();
+    }, Counted({1}), Counted({2, 3}));
+    auto id4 = scheduler.add(&Measure::size, Measure{}, Counted({5, 6}));
+
+    scheduler.executeAll();
+
+    ASSERT_THAT(scheduler.getResult<Counted>(id1).data, ::testing::ElementsAre(1, 2, 3, 4));
+    ASSERT_THAT(scheduler.getResult<Counted>(id2).data, ::testing::ElementsAre(8));
+    ASSERT_EQ(scheduler.getResult<size_t>(id3), 3);
+    ASSERT_EQ(scheduler.getResult<size_t>(id4), 2);
+    ASSERT_EQ(Counted::copies, 0);
+    // every constant is moved once from the temporary into its task, results are never moved
+    ASSERT_EQ(Counted::moves, 4);
+}
@@ -0,0 +1,129 @@
+#include "lib/task_pool.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <functional>
+
+namespace {
+
+class FunctionTask : public BaseTask {
+    std::function<void()> func;
+
+public:
+    FunctionTask(std::function<void()> f) : func(std::move(f)) {}
+
+    void Execute() override {
+        func();
+    }
+};
+
+}
+
+TEST(TaskPoolTest, park_without_spinning) {
+    TaskPool pool(TaskPoolOptions{.workers = 2, .spin_for = std::chrono::microseconds(0)});
+    std::atomic<int> counter = 0;
+
+    for (int i = 0; i < 100; ++i) {
+        pool.EnqueueTask(std::make_shared<FunctionTask>([&counter]() { counter++; }));
+    }
+    pool.WaitIdle();
+
+    ASSERT_THAT(counter.load(), 100);
+}
+
+TEST(TaskPoolTest, grows_under_backlog_and_retires) {
+    using namespace std::chrono_literals;
+
+    TaskPool pool(TaskPoolOptions{
+        .workers = 1,
+        .max_workers = 4,
+        .grow_after = 2ms,
+        .retire_after = 50ms,
+    });
+
+    for (int i = 0; i < 4; ++i) {
+        pool.EnqueueTask(std::make_shared<FunctionTask>([]() { std::this_thread::sleep_for(200ms); }));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.WaitIdle();
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_LT(elapsed, 400ms);
+    ASSERT_GT(pool.WorkersCount(), 1);
+
+    std::this_thread::sleep_for(300ms);
+    ASSERT_THAT(pool.WorkersCount(), 1);
+    // the retired workers took their slots with them, but not their counts
+    ASSERT_THAT(pool.Stats().tasks_executed, 4);
+}
+
+TEST(TaskPoolTest, busy_tasks_do_not_grow) {
+    using namespace std::chrono_literals;
+
+    TaskPool pool(TaskPoolOptions{
+        .workers = 1,
+        .max_workers = 4,
+        .grow_after = 1ms,
+    });
+
+    // a backlog of tasks that keep the worker on the cpu, short ones and ones running well
+    // past grow_after. Neither sleeps, so neither may count as blocked
+    auto spin = [](std::chrono::microseconds duration) {
+        return std::make_shared<FunctionTask>([duration]() {
+            const auto deadline = std::chrono::steady_clock::now() + duration;
+            while (std::chrono::steady_clock::now() < deadline) {}
+        });
+    };
+    for (int i = 0; i < 200; ++i) {
+        pool.EnqueueTask(spin(100us));
+    }
+    for (int i = 0; i < 10; ++i) {
+        pool.EnqueueTask(spin(20ms));
+    }
+    pool.WaitIdle();
+
+    ASSERT_THAT(pool.WorkersCount(), 1);
+}
+
+TEST(TaskPoolTest, default_options_do_not_grow) {
+    using namespace std::chrono_literals;
+
+    TaskPool pool(TaskPoolOptions{.workers = 1, .grow_after = 1ms});
+
+    for (int i = 0; i < 2; ++i) {
+        pool.EnqueueTask(std::make_shared<FunctionTask>([]() { std::this_thread::sleep_for(20ms); }));
+    }
+    pool.WaitIdle();
+
+    ASSERT_THAT(pool.WorkersCount(), 1);
+}
+
+TEST(TaskPoolTest, fixed_size_does_not_grow) {
+    using namespace std::chrono_literals;
+
+    TaskPool pool(1);
+
+    for (int i = 0; i < 2; ++i) {
+        pool.EnqueueTask(std::make_shared<FunctionTask>([]() { std::this_thread::sleep_for(50ms); }));
+    }
+    pool.WaitIdle();
+
+    ASSERT_THAT(pool.WorkersCount(), 1);
+}
+
+TEST(TaskPoolTest, enqueue_batch) {
+    TaskPool pool(TaskPoolOptions{.workers = 3});
+    std::atomic<int> counter = 0;
+
+    std::vector<std::shared_ptr<BaseTask>> batch;
+    for (int i = 0; i < 1000; ++i) {
+        batch.push_back(std::make_shared<FunctionTask>([&counter]() { counter++; }));
+    }
+
+    pool.EnqueueBatch(batch);
+    pool.WaitIdle();
+
+    ASSERT_THAT(counter.load(), 1000);
+}
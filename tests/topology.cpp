@@ -0,0 +1,80 @@
+#include "lib/scheduler.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+TEST(Topology, parse_cpu_list) {
+    ASSERT_THAT(ParseCpuList("0-3,8,10-11\n"), testing::ElementsAre(0, 1, 2, 3, 8, 10, 11));
+    ASSERT_THAT(ParseCpuList("5"), testing::ElementsAre(5));
+}
+
+TEST(Topology, detect) {
+    CpuTopology topology = CpuTopology::Detect();
+
+    ASSERT_GE(topology.NodesCount(), 1);
+    ASSERT_EQ(topology.distance.size(), topology.NodesCount());
+    ASSERT_EQ(topology.Neighbours(0).size(), topology.NodesCount() - 1);
+}
+
+TEST(Topology, allowed_cpus) {
+    std::vector<int> allowed = AllowedCpus();
+    ASSERT_FALSE(allowed.empty());
+
+    for (const auto& cpus : CpuTopology::Detect().node_cpus) {
+        for (int cpu : cpus) {
+            ASSERT_TRUE(std::binary_search(allowed.begin(), allowed.end(), cpu));
+        }
+    }
+}
+
+TEST(Topology, pinned_workers) {
+    std::vector<int> allowed = AllowedCpus();
+
+    for (auto affinity : {AffinityPolicy::Cpu, AffinityPolicy::Node}) {
+        TTaskScheduler scheduler(TaskPoolOptions{.workers = 2, .max_workers = 2, .affinity = affinity});
+
+        // the cpus the worker thread really may run on, as the kernel reports them
+        auto thread_cpus = [](int) {
+            std::vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            return cpus;
+        };
+
+        auto id1 = scheduler.add(thread_cpus, 0);
+        auto id2 = scheduler.add([](int x) { return x * 2; }, 20);
+
+        ASSERT_THAT(scheduler.getResult<int>(id2), 40);
+        ASSERT_EQ(scheduler.stats().pool.pin_failures, 0);
+
+#ifdef __linux__
+        const std::vector<int>& cpus = scheduler.getResult<std::vector<int>>(id1);
+        ASSERT_FALSE(cpus.empty());
+        for (int cpu : cpus) {
+            ASSERT_TRUE(std::binary_search(allowed.begin(), allowed.end(), cpu));
+        }
+
+        if (affinity == AffinityPolicy::Cpu) {
+            ASSERT_EQ(cpus.size(), 1);
+        } else {
+            auto nodes = CpuTopology::Detect().node_cpus;
+            ASSERT_TRUE(std::find(nodes.begin(), nodes.end(), cpus) != nodes.end());
+        }
+#endif
+    }
+}
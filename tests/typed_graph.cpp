@@ -0,0 +1,116 @@
+#include "lib/typed_graph.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+TEST(TypedGraph, basic) {
+    TTypedTaskGraph graph;
+
+    auto id1 = graph.add([](int x) { return x + 10; }, 10);
+    auto id2 = graph.add([](int x) { return std::to_string(x); }, id1);
+    auto id3 = graph.add([](int x) { return std::to_string(x).size(); }, graph.add([](int x) { return x * 100; }, 10));
+
+    graph.executeAll();
+
+    ASSERT_THAT(graph.getResult(id1), 20);
+    ASSERT_THAT(graph.getResult(id2), "20");
+    ASSERT_THAT(graph.getResult(id3), 4);
+}
+
+TEST(TypedGraph, quadratic_equation) {
+    TTypedTaskGraph graph;
+
+    float a = 1;
+    float b = -2;
+    float c = 0;
+
+    auto id1 = graph.add([](float a, float c) { return -4 * a * c; }, a, c);
+    auto id2 = graph.add([](float b, float v) { return b * b + v; }, b, id1);
+    auto id3 = graph.add([](float b, float d) { return -b + std::sqrt(d); }, b, id2);
+    auto id4 = graph.add([](float b, float d) { return -b - std::sqrt(d); }, b, id2);
+    auto id5 = graph.add([](float a, float v) { return v / (2 * a); }, a, id3);
+    auto id6 = graph.add([](float a, float v) { return v / (2 * a); }, a, id4);
+
+    graph.executeAll();
+
+    ASSERT_THAT(graph.getResult(id5), 2);
+    ASSERT_THAT(graph.getResult(id6), 0);
+}
+
+TEST(TypedGraph, wide_fan_in) {
+    TTypedTaskGraph graph(TaskPoolOptions{.workers = 4});
+
+    std::vector<TaskHandle<int>> leaves;
+    for (int i = 0; i < 100; ++i) {
+        leaves.push_back(graph.add([](int x) { return x; }, i));
+    }
+
+    auto sum = graph.add([](int a, int b) { return a + b; }, leaves[0], leaves[1]);
+    for (size_t i = 2; i < leaves.size(); ++i) {
+        sum = graph.add([](int a, int b) { return a + b; }, sum, leaves[i]);
+    }
+
+    graph.executeAll();
+    ASSERT_THAT(graph.getResult(sum), 4950);
+
+    graph.executeAll();
+    ASSERT_THAT(graph.getResult(sum), 4950);
+}
+
+TEST(TypedGraph, not_executed_error) {
+    TTypedTaskGraph graph;
+
+    auto id = graph.add([](int x) { return x; }, 10);
+
+    ASSERT_ANY_THROW(graph.getResult(id));
+}
+
+TEST(TypedGraph, foreign_handle_error) {
+    TTypedTaskGraph graph1;
+    TTypedTaskGraph graph2;
+
+    auto id = graph1.add([](int x) { return x; }, 10);
+
+    ASSERT_ANY_THROW(graph2.add([](int x) { return x; }, id));
+}
+
+namespace {
+
+struct Tracked {
+    static inline int alive = 0;
+
+    explicit Tracked(int v) : value(v) {
+        alive++;
+    }
+    Tracked(const Tracked& other) : value(other.value) {
+        alive++;
+    }
+    ~Tracked() {
+        alive--;
+    }
+
+    int value;
+};
+
+}
+
+TEST(TypedGraph, nodes_freed_with_graph) {
+    Tracked::alive = 0;
+
+    {
+        TTypedTaskGraph graph(2);
+
+        auto id1 = graph.add([](int x) { return Tracked(x); }, 1);
+        auto id2 = graph.add([](const Tracked& t) { return Tracked(t.value + 1); }, id1);
+        auto id3 = graph.add([](const Tracked& l, const Tracked& r) { return Tracked(l.value + r.value); }, id1, id2);
+
+        graph.executeAll();
+        ASSERT_EQ(graph.getResult(id3).value, 3);
+    }
+
+    ASSERT_EQ(Tracked::alive, 0);
+}
@@ -0,0 +1,103 @@
+#include "lib/graph_file.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+TEST(Validation, levels) {
+    TTaskScheduler scheduler;
+
+    int id1 = scheduler.add([](int a) { return a; }, 10);
+    int id2 = scheduler.add([](int b) { return b; }, 20);
+    int id3 = scheduler.add([](int a, int b) { return a + b; },
+        scheduler.getFutureResult<int>(id1), scheduler.getFutureResult<int>(id2));
+    int id4 = scheduler.add([](int a, int b) { return a + b; }, 30, scheduler.getFutureResult<int>(id3));
+    int id5 = scheduler.add([](int a, int b) { return a + b; },
+        scheduler.getFutureResult<int>(id3), scheduler.getFutureResult<int>(id4));
+
+    scheduler.finalize();
+
+    ASSERT_TRUE(scheduler.isFinalized());
+    ASSERT_THAT(scheduler.topologicalOrder(), testing::ElementsAre(id1, id2, id3, id4, id5));
+    ASSERT_THAT(scheduler.levels(), testing::ElementsAre(
+        testing::ElementsAre(id1, id2),
+        testing::ElementsAre(id3),
+        testing::ElementsAre(id4),
+        testing::ElementsAre(id5)));
+
+    scheduler.executeAll();
+    ASSERT_THAT(scheduler.getResult<int>(id5), 90);
+}
+
+TEST(Validation, add_drops_finalization) {
+    TTaskScheduler scheduler;
+
+    int id1 = scheduler.add([](int a) { return a; }, 10);
+    scheduler.finalize();
+
+    int id2 = scheduler.add([](int a) { return a * 2; }, scheduler.getFutureResult<int>(id1));
+
+    ASSERT_FALSE(scheduler.isFinalized());
+    ASSERT_THAT(scheduler.getResult<int>(id2), 20);
+}
+
+TEST(Validation, dangling_promise_error) {
+    TTaskScheduler scheduler;
+
+    scheduler.add([](int a) { return a; }, 10);
+
+    ASSERT_ANY_THROW(scheduler.add([](int x) { return x; }, Promise<int>(nullptr, 42)));
+}
+
+TEST(Validation, promise_type_error) {
+    TTaskScheduler scheduler;
+
+    int id = scheduler.add([](int a) { return a * 2; }, 10);
+
+    ASSERT_THROW(scheduler.add([](float x) { return x; }, scheduler.getFutureResult<float>(id)), std::runtime_error);
+    ASSERT_THROW(scheduler.add([](int x, float y) { return x + y; }, 1, scheduler.getFutureResult<float>(id)),
+        std::runtime_error);
+
+    // the rejected tasks leave the graph runnable
+    int id2 = scheduler.add([](int x) { return x + 1; }, scheduler.getFutureResult<int>(id));
+    scheduler.finalize();
+    ASSERT_THAT(scheduler.getResult<int>(id2), 21);
+}
+
+TEST(Validation, cycle_error) {
+    auto increment = [](int x) { return x + 1; };
+    TaskRegistry registry;
+    registry.addOne<int>("increment", increment);
+
+    // two constant tasks whose edges point at each other
+    GraphWriter writer;
+    writer.write<uint32_t>(0x31475354);
+    writer.write<uint32_t>(1);
+    writer.write<uint32_t>(2);
+    writer.write<uint32_t>(1);
+    writer.write(std::string("increment"));
+    for (int i = 0; i < 2; ++i) {
+        GraphWriter payload;
+        payload.write<uint8_t>(0);
+        payload.write<int>(i);
+
+        writer.write<uint32_t>(0);
+        writer.write<uint32_t>(payload.size());
+        writer.writeBytes(payload.data());
+    }
+    writer.write<uint32_t>(1);
+    writer.write(std::vector<int32_t>{1});
+    writer.write<uint32_t>(1);
+    writer.write(std::vector<int32_t>{0});
+
+    std::string path = (std::filesystem::temp_directory_path() / "cycle.tsg").string();
+    std::ofstream(path, std::ios::binary) << writer.data();
+
+    TTaskScheduler scheduler;
+    ASSERT_ANY_THROW(scheduler.load(path, registry));
+    ASSERT_FALSE(scheduler.isFinalized());
+
+    std::filesystem::remove(path);
+}